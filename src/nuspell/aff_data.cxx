@@ -24,6 +24,7 @@
 #include <locale>
 #include <sstream>
 #include <unordered_map>
+#include <unordered_set>
 
 using namespace std;
 
@@ -678,6 +679,7 @@ auto Aff_Data::parse_aff(istream& in, ostream& err_msg) -> bool
 	auto rules = vector<u16string>();
 	auto replacements = vector<pair<string, string>>();
 	auto map_related_chars = vector<string>();
+	auto keyboard_closeness = string();
 	auto phonetic_replacements = vector<pair<string, string>>();
 
 	max_compound_suggestions = 3;
@@ -873,8 +875,29 @@ auto Aff_Data::parse_aff(istream& in, ostream& err_msg) -> bool
 
 	// now fill data structures from temporary data
 	compound_rules = std::move(rules);
-	similarities.assign(begin(map_related_chars), end(map_related_chars));
+	similarities = vector<Similarity_Group>(begin(map_related_chars),
+	                                        end(map_related_chars));
+	this->keyboard_closeness = keyboard_closeness;
 	break_table = std::move(break_patterns);
+	// Punctuation in WORDCHARS and in BREAK patterns inside words keeps
+	// the parts together when tokenizing, spell() handles the rest.
+	auto tailor_joiner = [&](char32_t cp) {
+		auto c = tokenizer.classify(cp);
+		if (c != tokenizer.LETTER && c != tokenizer.DIGIT)
+			tokenizer.tailor(cp, tokenizer.MID_NUM_LET);
+	};
+	for (size_t i = 0; i != size(wordchars);) {
+		char32_t cp;
+		valid_u8_advance_cp(wordchars, i, cp);
+		tailor_joiner(cp);
+	}
+	for (auto& b : break_table.middle_word_breaks()) {
+		size_t i = 0;
+		char32_t cp;
+		valid_u8_advance_cp(b, i, cp);
+		if (i == size(b))
+			tailor_joiner(cp);
+	}
 	input_substr_replacer = std::move(input_conversion);
 	output_substr_replacer = std::move(output_conversion);
 	this->replacements = std::move(replacements);
@@ -887,6 +910,19 @@ auto Aff_Data::parse_aff(istream& in, ostream& err_msg) -> bool
 	}
 	this->prefixes = std::move(prefixes);
 	this->suffixes = std::move(suffixes);
+	// Same as !outer_affix_NOT_valid<FULL_WORD>() && !is_circumfix()
+	// in Checker.
+	auto is_outer = [&](auto& x) {
+		auto& f = x.cont_flags;
+		return !f.contains(compound_onlyin_flag) &&
+		       !f.contains(need_affix_flag) &&
+		       !f.contains(circumfix_flag);
+	};
+	prefix_index.build(this->prefixes, is_outer);
+	suffix_index.build(this->suffixes, is_outer);
+	compound_pattern_replacements =
+	    any_of(begin(compound_patterns), end(compound_patterns),
+	           [](auto& p) { return !p.replacement.empty(); });
 
 	return in.eof() && !error_happened; // true for success
 }
@@ -1027,7 +1063,122 @@ auto Aff_Data::parse_dic(istream& in, ostream& err_msg) -> bool
 			break;
 		}
 	}
+#ifdef NUSPELL_WORD_LIST_FILTER
+	// Most lookups during affix stripping and compounding are misses.
+	words.build_filter();
+#endif
+#ifdef NUSPELL_WORD_LIST_PERFECT_HASH
+	// The word list does not change after this point.
+	words.build_perfect_hash();
+#endif
+#ifdef NUSPELL_ROOT_TRIE
+	if (compound_flag || compound_begin_flag || compound_middle_flag ||
+	    compound_last_flag || !compound_rules.empty() ||
+	    !similarities.empty())
+		build_root_trie();
+#endif
+	if (!try_chars.empty())
+		build_bigrams();
 	return in.eof() && success; // success if we reached eof
 }
+
+auto Aff_Data::build_root_trie() -> void
+{
+	auto roots = vector<string_view>();
+	roots.reserve(words.size());
+	for (size_t i = 0; i != words.bucket_count(); ++i)
+		for (auto& we : words.bucket_data(i))
+			roots.push_back(we.first);
+	sort(begin(roots), end(roots));
+	roots.erase(unique(begin(roots), end(roots)), end(roots));
+	root_trie.build(begin(roots), end(roots), identity());
+}
+
+/**
+ * @internal
+ * @brief Fills the set of code point pairs that can appear in a correct word.
+ *
+ * Pairs inside roots and affixes are taken as they are. After a prefix and
+ * before a suffix can come anything because of stripping. With compounding,
+ * the end of any part can also be followed by the start of any part. The set
+ * is left empty, which means unknown, when compound patterns change the
+ * joints or when there are too many such pairs.
+ */
+auto Aff_Data::build_bigrams() -> void
+{
+	bigrams.clear();
+	auto compounding = compound_flag || compound_begin_flag ||
+	                   compound_middle_flag || compound_last_flag ||
+	                   !compound_rules.empty();
+	if (compounding && compound_pattern_replacements)
+		return;
+	auto first_cp = [](string_view s) {
+		auto i = size_t(0);
+		char32_t cp;
+		valid_u8_advance_cp(s, i, cp);
+		return cp;
+	};
+	auto last_cp = [](string_view s) {
+		auto i = s.size();
+		char32_t cp;
+		valid_u8_reverse_cp(s, i, cp);
+		return cp;
+	};
+	auto part_ends = unordered_set<char32_t>();
+	auto part_starts = unordered_set<char32_t>();
+	auto any_end = false;
+	auto any_start = false;
+	for (auto& x : prefixes) {
+		bigrams.insert_bigrams_of(x.appending);
+		if (x.appending.empty()) {
+			any_start = true;
+			continue;
+		}
+		bigrams.insert_any_after(last_cp(x.appending));
+		part_starts.insert(first_cp(x.appending));
+		part_ends.insert(last_cp(x.appending));
+	}
+	for (auto& x : suffixes) {
+		bigrams.insert_bigrams_of(x.appending);
+		if (x.appending.empty()) {
+			any_end = true;
+			continue;
+		}
+		bigrams.insert_any_before(first_cp(x.appending));
+		part_starts.insert(first_cp(x.appending));
+		part_ends.insert(last_cp(x.appending));
+	}
+	for (size_t i = 0; i != words.bucket_count(); ++i) {
+		for (auto& we : words.bucket_data(i)) {
+			auto& w = we.first;
+			bigrams.insert_bigrams_of(w);
+			if (!compounding || w.empty())
+				continue;
+			if (!any_start && !any_end) {
+				part_starts.insert(first_cp(w));
+				part_ends.insert(last_cp(w));
+				continue;
+			}
+			for (size_t j = 0, next_j = 0; j != w.size();
+			     j = next_j) {
+				char32_t cp;
+				valid_u8_advance_cp(w, next_j, cp);
+				if (any_start || j == 0)
+					part_starts.insert(cp);
+				if (any_end || next_j == w.size())
+					part_ends.insert(cp);
+			}
+		}
+	}
+	if (!compounding)
+		return;
+	if (part_ends.size() * part_starts.size() > 1 << 16) {
+		bigrams.clear();
+		return;
+	}
+	for (auto a : part_ends)
+		for (auto b : part_starts)
+			bigrams.insert(a, b);
+}
 NUSPELL_END_INLINE_NAMESPACE
 } // namespace nuspell
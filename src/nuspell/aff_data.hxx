@@ -21,6 +21,7 @@
 
 #include "nuspell_export.h"
 #include "structures.hxx"
+#include "utils.hxx"
 
 #include <iosfwd>
 #include <unicode/locid.h>
@@ -94,8 +95,14 @@ struct Aff_Data {
 
 	// spell checking options
 	Word_List words = {};
+	Static_Trie<char> root_trie = {}; // over the keys in words, optional
+	Bigram_Set bigrams = {};          // adjacent pairs in words, optional
+	// affixed words with the result of check_simple_word(), optional
+	std::unordered_map<std::string, Flag_Set> hot_forms = {};
 	Prefix_Table prefixes = {};
 	Suffix_Table suffixes = {};
+	Affix_Flag_Index prefix_index = {}; // optional
+	Affix_Flag_Index suffix_index = {}; // optional
 
 	bool complex_prefixes = {};
 	bool fullstrip = {};
@@ -121,11 +128,12 @@ struct Aff_Data {
 	std::string ignored_chars = {};
 	icu::Locale icu_locale = {};
 	Substr_Replacer output_substr_replacer = {};
+	Word_Tokenizer tokenizer = {};
 
 	// suggestion options
 	Replacement_Table replacements = {};
-	std::vector<Similarity_Group> similarities = {};
-	std::string keyboard_closeness = {};
+	Similarity_Table similarities = {};
+	Keyboard_Table keyboard_closeness = {};
 	std::string try_chars = {};
 	// Phonetic_Table phonetic_table = {};
 
@@ -155,6 +163,7 @@ struct Aff_Data {
 	unsigned short compound_syllable_max = {};
 	std::string compound_syllable_vowels = {};
 	std::vector<Compound_Pattern> compound_patterns = {};
+	bool compound_pattern_replacements = {}; // some pattern has one
 
 	// data members used only while parsing
 	Flag_Type flag_type = {};
@@ -164,6 +173,8 @@ struct Aff_Data {
 
 	auto parse_aff(std::istream& in, std::ostream& err_msg) -> bool;
 	auto parse_dic(std::istream& in, std::ostream& err_msg) -> bool;
+	auto build_root_trie() -> void;
+	auto build_bigrams() -> void;
 	auto parse_aff_dic(std::istream& aff, std::istream& dic,
 	                   std::ostream& err_msg)
 	{
@@ -303,6 +303,11 @@ auto Checker::check_simple_word(std::string& s,
 			continue;
 		return &word_flags;
 	}
+	if (!hot_forms.empty()) {
+		auto it = hot_forms.find(s);
+		if (it != end(hot_forms))
+			return &it->second;
+	}
 	{
 		auto ret3 = strip_suffix_only(s, skip_hidden_homonym);
 		if (ret3)
@@ -359,6 +364,30 @@ auto Checker::check_simple_word(std::string& s,
 	return nullptr;
 }
 
+/**
+ * @internal
+ * @brief Adds a word to the set of hot forms.
+ *
+ * The hot forms are looked up in check_simple_word() right after the word
+ * list, before any affix stripping. Only words that are accepted through
+ * affixes are added, with the same result for both values of
+ * Hidden_Homonym, so the lookup never changes the result.
+ *
+ * @param word a word in the internal form, after input conversion
+ * @return true if the word was added
+ */
+auto Checker::add_hot_form(std::string& word) -> bool
+{
+	auto [first, last] = words.equal_range(word);
+	if (first != last || hot_forms.count(word))
+		return false;
+	auto res = check_simple_word(word, SKIP_HIDDEN_HOMONYM);
+	if (!res || res != check_simple_word(word, ACCEPT_HIDDEN_HOMONYM))
+		return false;
+	hot_forms.emplace(word, *res);
+	return true;
+}
+
 template <class AffixT>
 class To_Root_Unroot_RAII {
       private:
@@ -1424,8 +1453,8 @@ auto Checker::check_compound(std::string& word,
 			return ret;
 	}
 	if (!compound_rules.empty()) {
-		auto words_data = vector<const Flag_Set*>();
-		return check_compound_with_rules(word, words_data, 0, part,
+		auto& state = compound_rules.start_state();
+		return check_compound_with_rules(word, state, 0, part,
 		                                 allow_bad_forceucase);
 	}
 
@@ -1454,9 +1483,15 @@ auto Checker::check_compound(std::string& word, size_t start_pos,
 			return {};
 		valid_u8_reverse_index(word, last_i);
 	}
+	auto part1_max_end = max_end_of_compound_part(word, start_pos, part);
 	for (; i <= last_i; valid_u8_advance_index(word, i)) {
-		auto part1_entry = check_compound_classic<m>(
-		    word, start_pos, i, num_part, part, allow_bad_forceucase);
+		auto part1_entry = Compounding_Result();
+		if (i <= part1_max_end)
+			part1_entry = check_compound_classic<m>(
+			    word, start_pos, i, num_part, part,
+			    allow_bad_forceucase);
+		else if (!compound_pattern_replacements)
+			break;
 
 		if (part1_entry)
 			return part1_entry;
@@ -1470,6 +1505,56 @@ auto Checker::check_compound(std::string& word, size_t start_pos,
 	return {};
 }
 
+/**
+ * @internal
+ * @brief Finds upper limit for the end of the first part of a compound.
+ *
+ * A first part word[start_pos, i) can be valid only if it is a root, possibly
+ * with a prefix and/or suffix. Without the appendings and with the strippings
+ * added back, that is a prefix of some root. The trie of roots tells how far
+ * such a prefix can go.
+ *
+ * @param word whole word.
+ * @param start_pos where the first part starts.
+ * @param part buffer, gets overwritten.
+ * @return Index in the word, the first part can not end after it.
+ */
+auto Checker::max_end_of_compound_part(std::string_view word, size_t start_pos,
+                                       std::string& part) const -> size_t
+{
+	if (root_trie.empty())
+		return word.npos;
+	auto walk = [&](auto node, size_t i) {
+		for (; i < size(word); ++i) {
+			node = root_trie.child(node, word[i]);
+			if (node == root_trie.npos)
+				break;
+		}
+		return i;
+	};
+	auto max_sfx = suffixes.max_appending_size();
+	auto ret = walk(root_trie.root(), start_pos) + max_sfx;
+	if (ret >= size(word))
+		return word.npos;
+
+	part.assign(word, start_pos);
+	for (auto& pe : prefixes.iterate_prefixes_of(part)) {
+		auto node = root_trie.root();
+		for (size_t j = 0; j != size(pe.stripping); ++j) {
+			node = root_trie.child(node, pe.stripping[j]);
+			if (node == root_trie.npos)
+				break;
+		}
+		if (node == root_trie.npos)
+			continue;
+		auto end = walk(node, start_pos + size(pe.appending));
+		ret = max(ret, end + max_sfx);
+		if (ret >= size(word))
+			return word.npos;
+	}
+	return ret;
+}
+
 auto are_three_code_points_equal(string_view word, size_t i) -> bool
 {
 	auto cp = valid_u8_next_cp(word, i);
@@ -1930,7 +2015,7 @@ auto Checker::count_syllables(std::string_view word) const -> size_t
 }
 
 auto Checker::check_compound_with_rules(
-    std::string& word, std::vector<const Flag_Set*>& words_data,
+    std::string& word, const Compound_Rule_Table::State& state,
     size_t start_pos, std::string& part, Forceucase allow_bad_forceucase) const
     -> Compounding_Result
 {
@@ -1950,7 +2035,22 @@ auto Checker::check_compound_with_rules(
 			return {};
 		valid_u8_reverse_index(word, last_i);
 	}
+	// The first part must be a root, walk the trie of roots along with i.
+	auto use_trie = !root_trie.empty();
+	auto node = root_trie.root();
+	auto walked_i = start_pos;
+	auto part1_state = Compound_Rule_Table::State();
+	auto part2_state = Compound_Rule_Table::State();
 	for (; i <= last_i; valid_u8_advance_index(word, i)) {
+		if (use_trie) {
+			for (; walked_i != i && node != root_trie.npos;
+			     ++walked_i)
+				node = root_trie.child(node, word[walked_i]);
+			if (node == root_trie.npos)
+				break;
+			if (!root_trie.has_values(node))
+				continue;
+		}
 		part.assign(word, start_pos, i - start_pos);
 		auto part1_entry = Word_List::const_pointer();
 		auto range = words.equal_range(part);
@@ -1965,8 +2065,10 @@ auto Checker::check_compound_with_rules(
 		}
 		if (!part1_entry)
 			continue;
-		words_data.push_back(&part1_entry->second);
-		AT_SCOPE_EXIT(words_data.pop_back());
+		// No rule can start like this, whatever comes next.
+		if (!compound_rules.advance(state, part1_entry->second,
+		                            part1_state))
+			continue;
 
 		part.assign(word, i, word.npos);
 		auto part2_entry = Word_List::const_pointer();
@@ -1984,11 +2086,9 @@ auto Checker::check_compound_with_rules(
 			goto try_recursive;
 
 		{
-			words_data.push_back(&part2_entry->second);
-			AT_SCOPE_EXIT(words_data.pop_back());
-
-			auto m = compound_rules.match_any_rule(words_data);
-			if (!m)
+			compound_rules.advance(part1_state, part2_entry->second,
+			                       part2_state);
+			if (!compound_rules.is_accepting(part2_state))
 				goto try_recursive;
 			if (compound_force_uppercase && !allow_bad_forceucase &&
 			    part2_entry->second.contains(
@@ -1999,7 +2099,7 @@ auto Checker::check_compound_with_rules(
 		}
 	try_recursive:
 		part2_entry = check_compound_with_rules(
-		    word, words_data, i, part, allow_bad_forceucase);
+		    word, part1_state, i, part, allow_bad_forceucase);
 		if (part2_entry)
 			return {part2_entry};
 	}
@@ -104,6 +104,7 @@ struct Checker : public Aff_Data {
 	auto check_simple_word(std::string& word,
 	                       Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> const Flag_Set*;
+	auto add_hot_form(std::string& word) -> bool;
 
 	template <Affixing_Mode m>
 	auto affix_NOT_valid(const Prefix& a) const;
@@ -256,6 +257,9 @@ struct Checker : public Aff_Data {
 	                    Forceucase allow_bad_forceucase) const
 	    -> Compounding_Result;
 
+	auto max_end_of_compound_part(std::string_view word, size_t start_pos,
+	                              std::string& part) const -> size_t;
+
 	template <Affixing_Mode m = AT_COMPOUND_BEGIN>
 	auto check_compound_classic(std::string& word, size_t start_pos,
 	                            size_t i, size_t num_part,
@@ -284,12 +288,10 @@ struct Checker : public Aff_Data {
 
 	auto count_syllables(std::string_view word) const -> size_t;
 
-	auto check_compound_with_rules(std::string& word,
-	                               std::vector<const Flag_Set*>& words_data,
-	                               size_t start_pos, std::string& part,
-	                               Forceucase allow_bad_forceucase) const
-
-	    -> Compounding_Result;
+	auto check_compound_with_rules(
+	    std::string& word, const Compound_Rule_Table::State& state,
+	    size_t start_pos, std::string& part,
+	    Forceucase allow_bad_forceucase) const -> Compounding_Result;
 	auto is_rep_similar(std::string& word) const -> bool;
 };
 
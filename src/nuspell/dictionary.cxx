@@ -170,5 +170,123 @@ auto Dictionary::suggest(std::string_view word,
 		return;
 	suggest_priv(word, out);
 }
+
+/**
+ * @brief Splits text into words that can be passed to spell()
+ *
+ * This is a fast alternative to ICU's word break iterator. Words are runs of
+ * letters and digits, joined by apostrophes, and numbers also by periods and
+ * commas, as in UAX #29. The punctuation in WORDCHARS and the single character
+ * patterns of BREAK, like hyphen, join words too, spell() breaks them as
+ * needed. Unlike ICU, words in scripts without spaces, like Chinese and Thai,
+ * are not split.
+ *
+ * @param text text in UTF-8
+ * @param callback called for each word, with a view into text
+ */
+auto Dictionary::tokenize(
+    std::string_view text,
+    const std::function<void(std::string_view)>& callback) const -> void
+{
+	tokenizer.for_each_word(text, callback);
+}
+
+/**
+ * @brief Generates all word forms of the dictionary
+ *
+ * Gives each form that is correct on its own, without compounding: the roots
+ * and the roots with affixes. The same form can be given more than once if it
+ * comes from different roots. The order is unspecified, but it is always the
+ * same for the same dictionary.
+ *
+ * The word list can be split into parts that can be expanded independently,
+ * e.g. each in its own thread. Concatenating the output of the parts from 0
+ * to num_parts - 1 gives the same output as expanding the whole dictionary.
+ *
+ * @param callback called for each word form, in UTF-8
+ * @param two_level also generate forms with two suffixes
+ * @param part the part to expand, less than num_parts
+ * @param num_parts the number of parts
+ */
+auto Dictionary::expand_all(
+    const std::function<void(std::string_view)>& callback, bool two_level,
+    size_t part, size_t num_parts) const -> void
+{
+	if (part >= num_parts)
+		return;
+	auto n = words.bucket_count();
+	auto first = n * part / num_parts;
+	auto last = n * (part + 1) / num_parts;
+	auto forms = List_Strings();
+	for (auto i = first; i != last; ++i) {
+		for (auto& we : words.bucket_data(i)) {
+			expand_root_word(we, two_level, forms);
+			for (auto& f : forms) {
+				output_substr_replacer.replace(f);
+				callback(f);
+			}
+		}
+	}
+}
+
+/**
+ * @brief Precomputes the results for the most frequent affixed words
+ *
+ * Words that are correct only with affixes are found in a single hash lookup
+ * afterwards, without affix stripping. This speeds up checking of text that
+ * consists mostly of common words. The results of spell() and suggest() do
+ * not change.
+ *
+ * The list has one word per line, most frequent first. Only the first field
+ * of each line is taken, so lines like "word 1234" are allowed. Reading stops
+ * after @p max_forms words are added. Previous hot forms are discarded.
+ *
+ * @param frequency_list the words, in UTF-8
+ * @param max_forms the maximum number of words to add
+ */
+auto Dictionary::build_hot_forms(std::istream& frequency_list,
+                                 size_t max_forms) -> void
+{
+	hot_forms.clear();
+	auto line = string();
+	auto word = string();
+	while (hot_forms.size() < max_forms && getline(frequency_list, line)) {
+		auto i = line.find_first_not_of(" \t\r");
+		if (i == line.npos)
+			continue;
+		auto j = line.find_first_of(" \t\r", i);
+		word.assign(line, i, j - i);
+		if (!validate_utf8(word))
+			continue;
+		input_substr_replacer.replace(word);
+		erase_chars(word, ignored_chars);
+		add_hot_form(word);
+	}
+}
+
+/**
+ * @brief Precomputes the results for affixed words up to a size budget
+ *
+ * Same as build_hot_forms(std::istream&,size_t), but without a frequency
+ * list. The words are generated from the roots in unspecified order until
+ * @p max_forms words are added.
+ *
+ * @param max_forms the maximum number of words to add
+ */
+auto Dictionary::build_hot_forms(size_t max_forms) -> void
+{
+	hot_forms.clear();
+	auto forms = List_Strings();
+	for (size_t i = 0; i != words.bucket_count(); ++i) {
+		for (auto& we : words.bucket_data(i)) {
+			expand_root_word(we, false, forms);
+			for (auto& f : forms) {
+				if (hot_forms.size() >= max_forms)
+					return;
+				add_hot_form(f);
+			}
+		}
+	}
+}
 NUSPELL_END_INLINE_NAMESPACE
 } // namespace nuspell
@@ -27,6 +27,7 @@
 #include "suggester.hxx"
 
 #include <filesystem>
+#include <functional>
 
 namespace nuspell {
 NUSPELL_BEGIN_INLINE_NAMESPACE
@@ -65,6 +66,15 @@ class NUSPELL_EXPORT Dictionary : private Suggester {
 	auto spell(std::string_view word) const -> bool;
 	auto suggest(std::string_view word, std::vector<std::string>& out) const
 	    -> void;
+	auto tokenize(std::string_view text,
+	              const std::function<void(std::string_view)>& callback)
+	    const -> void;
+	auto expand_all(const std::function<void(std::string_view)>& callback,
+	                bool two_level = false, size_t part = 0,
+	                size_t num_parts = 1) const -> void;
+	auto build_hot_forms(std::istream& frequency_list, size_t max_forms)
+	    -> void;
+	auto build_hot_forms(size_t max_forms) -> void;
 };
 
 NUSPELL_END_INLINE_NAMESPACE
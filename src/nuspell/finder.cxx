@@ -20,7 +20,11 @@
 #include "utils.hxx"
 
 #include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <climits>
 #include <filesystem>
+#include <fstream>
 #include <set>
 
 #if __has_include(<unistd.h>)
@@ -337,6 +341,193 @@ auto search_default_dirs_for_dicts() -> vector<fs_path>
 	return dict_list;
 }
 
+namespace {
+/**
+ * @internal
+ * @brief The dictionaries found in one directory, entry of the cache.
+ */
+struct Dict_Dir_Entry {
+	fs_path dir;
+	long long mtime = 0;
+	vector<fs_path> dicts;
+};
+constexpr auto dict_cache_header = "nuspell dictionary cache 1";
+constexpr auto missing_dir_mtime = LLONG_MIN;
+} // namespace
+
+static auto path_to_utf8(const fs_path& p) -> string
+{
+	auto s = p.u8string(); // is std::u8string since C++20
+	return string(begin(s), end(s));
+}
+
+static auto utf8_to_path(string_view s) -> fs_path
+{
+#if __cpp_char8_t
+	return fs_path(u8string(begin(s), end(s)));
+#else
+	return filesystem::u8path(begin(s), end(s));
+#endif
+}
+
+static auto read_dict_cache(const fs_path& cache_path)
+    -> vector<Dict_Dir_Entry>
+{
+	auto cache = vector<Dict_Dir_Entry>();
+	auto in = ifstream(cache_path);
+	auto line = string();
+	if (!getline(in, line) || line != dict_cache_header)
+		return cache;
+	while (getline(in, line)) {
+		if (begins_with(line, "dir ")) {
+			auto& e = cache.emplace_back();
+			auto first = line.data() + 4;
+			auto last = line.data() + line.size();
+			auto [ptr, ec] = from_chars(first, last, e.mtime);
+			if (ec != errc() || ptr == last || *ptr != ' ')
+				return {};
+			e.dir = utf8_to_path(string_view(line).substr(
+			    ptr + 1 - line.data()));
+		}
+		else if (begins_with(line, "aff ") && !cache.empty()) {
+			auto aff = string_view(line).substr(4);
+			cache.back().dicts.push_back(utf8_to_path(aff));
+		}
+		else {
+			return {}; // corrupted cache, search again
+		}
+	}
+	return cache;
+}
+
+static auto write_dict_cache(const fs_path& cache_path,
+                             const vector<Dict_Dir_Entry>& cache) -> void
+{
+	auto ec = error_code();
+	filesystem::create_directories(cache_path.parent_path(), ec);
+	// Write to a unique temporary file and rename it, so concurrent
+	// processes never read a partially written cache.
+	auto tmp_path = cache_path;
+	tmp_path += ".tmp" + to_string(chrono::steady_clock::now()
+	                                   .time_since_epoch()
+	                                   .count());
+	{
+		auto out = ofstream(tmp_path);
+		out << dict_cache_header << '\n';
+		for (auto& e : cache) {
+			out << "dir " << e.mtime << ' ' << path_to_utf8(e.dir)
+			    << '\n';
+			for (auto& d : e.dicts)
+				out << "aff " << path_to_utf8(d) << '\n';
+		}
+		if (!out.flush()) {
+			out.close();
+			filesystem::remove(tmp_path, ec);
+			return;
+		}
+	}
+	filesystem::rename(tmp_path, cache_path, ec);
+	if (ec)
+		filesystem::remove(tmp_path, ec);
+}
+
+/**
+ * @brief Search the directories for dictionaries, using a cache file.
+ *
+ * The result is the same as from search_dirs_for_dicts(), but the
+ * dictionaries of each absolute directory path are stored in the file @p
+ * cache_path together with the modification time of the directory. On the
+ * next call the directories whose modification time did not change are not
+ * iterated, only their time is read. A directory changes its time when files
+ * are added, removed or renamed in it. Relative paths, like ".", are always
+ * iterated. The file is rewritten when something changed, errors with it are
+ * ignored.
+ *
+ * @param[in]  dir_paths list of paths to directories
+ * @param[in]  cache_path path to the cache file, e.g. from
+ * get_default_dict_cache_path()
+ * @param[out] dict_list vector that receives the paths of the found
+ * dictionaries
+ */
+auto search_dirs_for_dicts_cached(const vector<fs_path>& dir_paths,
+                                  const fs_path& cache_path,
+                                  vector<fs_path>& dict_list) -> void
+{
+	using file_clock = filesystem::file_time_type::clock;
+	auto old_cache = read_dict_cache(cache_path);
+	auto new_cache = vector<Dict_Dir_Entry>();
+	auto changed = false;
+	auto now = file_clock::now();
+	for (auto& dir : dir_paths) {
+		if (dir.is_relative()) {
+			search_dir_for_dicts(dir, dict_list);
+			continue;
+		}
+		auto ec = error_code();
+		auto time = filesystem::last_write_time(dir, ec);
+		auto mtime = ec ? missing_dir_mtime
+		                : static_cast<long long>(
+		                      time.time_since_epoch().count());
+		auto it = find_if(begin(old_cache), end(old_cache),
+		                  [&](auto& e) { return e.dir == dir; });
+		if (it != end(old_cache) && it->mtime == mtime) {
+			dict_list.insert(end(dict_list), begin(it->dicts),
+			                 end(it->dicts));
+			new_cache.push_back(*it);
+			continue;
+		}
+		changed = true;
+		auto e = Dict_Dir_Entry{dir, mtime, {}};
+		search_dir_for_dicts(dir, e.dicts);
+		dict_list.insert(end(dict_list), begin(e.dicts), end(e.dicts));
+
+		// A directory changed in the last moments can change again
+		// within the resolution of the time, do not trust it yet.
+		if (!ec && now - time < chrono::seconds(2))
+			continue;
+		auto has_newline = [](const fs_path& p) {
+			return path_to_utf8(p).find('\n') != string::npos;
+		};
+		if (has_newline(dir) ||
+		    any_of(begin(e.dicts), end(e.dicts), has_newline))
+			continue;
+		new_cache.push_back(std::move(e));
+	}
+	if (changed || size(new_cache) != size(old_cache))
+		write_dict_cache(cache_path, new_cache);
+}
+
+/**
+ * @brief Get the default path of the cache file for
+ * search_dirs_for_dicts_cached().
+ *
+ * It is in the user's cache directory, e.g. ~/.cache/nuspell on Linux.
+ *
+ * @return the path, or empty path if the cache directory is not known.
+ */
+auto get_default_dict_cache_path() -> fs_path
+{
+	auto p = fs_path();
+#if _WIN32
+	auto local_app_data = _wgetenv(L"LOCALAPPDATA");
+	if (local_app_data && *local_app_data)
+		p = fs_path(local_app_data) / L"nuspell";
+#elif _POSIX_VERSION
+	auto xdg_cache_home = getenv("XDG_CACHE_HOME");
+	if (xdg_cache_home && *xdg_cache_home)
+		p = fs_path(xdg_cache_home) / "nuspell";
+	else if (auto home = getenv("HOME"))
+#if defined(__APPLE__) && defined(__MACH__)
+		p = fs_path(home) / "Library/Caches/nuspell";
+#else
+		p = fs_path(home) / ".cache/nuspell";
+#endif
+#endif
+	if (!p.empty())
+		p /= "dictionaries";
+	return p;
+}
+
 auto append_default_dir_paths(std::vector<std::string>& paths) -> void
 {
 	auto out = vector<fs_path>();
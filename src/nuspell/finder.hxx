@@ -56,6 +56,11 @@ search_dirs_for_dicts(const std::vector<std::filesystem::path>& dir_paths,
                       std::vector<std::filesystem::path>& dict_list) -> void;
 NUSPELL_EXPORT auto search_default_dirs_for_dicts()
     -> std::vector<std::filesystem::path>;
+NUSPELL_EXPORT auto search_dirs_for_dicts_cached(
+    const std::vector<std::filesystem::path>& dir_paths,
+    const std::filesystem::path& cache_path,
+    std::vector<std::filesystem::path>& dict_list) -> void;
+NUSPELL_EXPORT auto get_default_dict_cache_path() -> std::filesystem::path;
 
 NUSPELL_DEPRECATED_EXPORT
 auto append_default_dir_paths(std::vector<std::string>& paths) -> void;
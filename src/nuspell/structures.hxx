@@ -23,6 +23,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <forward_list>
 #include <functional>
 #include <iterator>
@@ -30,6 +31,8 @@
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -521,6 +524,230 @@ struct identity {
 	}
 };
 
+/**
+ * @internal
+ * @brief The splitmix64 finalizer, spreads the hash over all the bits.
+ */
+inline auto mix_hash(uint64_t x) -> uint64_t
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111eb;
+	x ^= x >> 31;
+	return x;
+}
+
+/**
+ * @internal
+ * @brief Blocked Bloom filter over hash values.
+ *
+ * Each value sets three bits in a single 64-bit block, so a query touches only
+ * one cache line. A query can give false positives, but never false
+ * negatives.
+ */
+class Hash_Filter {
+	std::vector<uint64_t> blocks;
+
+	auto get_block_and_mask(size_t hash) const
+	    -> std::pair<size_t, uint64_t>
+	{
+		auto x = mix_hash(hash);
+		auto block = size_t(x >> 32) & (blocks.size() - 1);
+		auto mask = uint64_t(1) << (x & 63);
+		mask |= uint64_t(1) << ((x >> 6) & 63);
+		mask |= uint64_t(1) << ((x >> 12) & 63);
+		return {block, mask};
+	}
+
+      public:
+	/**
+	 * @brief Clears the filter and sizes it for the given number of values.
+	 *
+	 * It uses around 16 bits per value.
+	 */
+	auto reset(size_t count) -> void
+	{
+		auto n = size_t(1);
+		while (n * 4 < count)
+			n <<= 1;
+		blocks.assign(n, 0);
+	}
+	auto clear() -> void { blocks.clear(); }
+	auto empty() const { return blocks.empty(); }
+	auto insert(size_t hash) -> void
+	{
+		auto [block, mask] = get_block_and_mask(hash);
+		blocks[block] |= mask;
+	}
+	/**
+	 * @brief Checks if a value with that hash may have been inserted.
+	 *
+	 * An empty (not built) filter returns true for every hash.
+	 */
+	auto may_contain(size_t hash) const -> bool
+	{
+		if (blocks.empty())
+			return true;
+		auto [block, mask] = get_block_and_mask(hash);
+		return (blocks[block] & mask) == mask;
+	}
+};
+
+/**
+ * @internal
+ * @brief Minimal perfect hash function over a fixed set of hash values.
+ *
+ * It maps each of the n values given to build() to a distinct number in
+ * [0, n) and is built with the PTHash method. The values are split into
+ * buckets of around three, and for each bucket, from the largest to the
+ * smallest, a pilot number is searched for that places all of its values into
+ * free positions of a table slightly larger than n. The few values placed
+ * past n are then remapped to the positions left free below n. A lookup
+ * computes the bucket and the position from the bucket's pilot. Values that
+ * were not given to build() are mapped to some arbitrary position, so the
+ * caller must check what it finds there.
+ */
+class Perfect_Hash {
+	std::vector<uint32_t> pilots;
+	std::vector<uint32_t> remap;
+	size_t num_keys = 0;
+	size_t table_size = 0;
+	uint64_t seed = 0;
+
+	auto bucket_of(size_t hash) const -> size_t
+	{
+		return mix_hash(hash ^ seed) % pilots.size();
+	}
+	auto position(size_t hash, uint32_t pilot) const -> size_t
+	{
+		return mix_hash(hash ^ mix_hash(seed + pilot)) % table_size;
+	}
+	auto try_build(const std::vector<size_t>& hashes) -> bool;
+
+      public:
+	auto build(const std::vector<size_t>& hashes) -> bool;
+	auto clear() -> void
+	{
+		pilots.clear();
+		remap.clear();
+		num_keys = 0;
+		table_size = 0;
+	}
+	auto empty() const { return num_keys == 0; }
+	auto size() const { return num_keys; }
+	auto operator()(size_t hash) const -> size_t
+	{
+		auto p = position(hash, pilots[bucket_of(hash)]);
+		if (p >= num_keys)
+			p = remap[p - num_keys];
+		return p;
+	}
+};
+
+/**
+ * @brief Builds the function over the given hash values.
+ *
+ * @return false if the values are not distinct or no function was found, and
+ * then the object is left empty.
+ */
+auto inline Perfect_Hash::build(const std::vector<size_t>& hashes) -> bool
+{
+	clear();
+	if (hashes.empty())
+		return false;
+	// Equal values can not be separated by any pilot.
+	auto sorted = hashes;
+	std::sort(begin(sorted), end(sorted));
+	if (std::adjacent_find(begin(sorted), end(sorted)) != end(sorted))
+		return false;
+	for (seed = 0; seed != 4; ++seed) {
+		if (try_build(hashes))
+			return true;
+	}
+	clear();
+	return false;
+}
+
+auto inline Perfect_Hash::try_build(const std::vector<size_t>& hashes) -> bool
+{
+	auto n = std::size(hashes);
+	num_keys = n;
+	table_size = n + n / 16 + 1;
+	pilots.assign(n / 3 + 1, 0);
+	auto m = std::size(pilots);
+
+	// group the values by bucket, counting sort
+	auto offsets = std::vector<uint32_t>(m + 1);
+	for (auto h : hashes)
+		++offsets[bucket_of(h) + 1];
+	auto max_bucket_size = size_t(0);
+	for (size_t b = 0; b != m; ++b) {
+		max_bucket_size = std::max<size_t>(max_bucket_size,
+		                                   offsets[b + 1]);
+		offsets[b + 1] += offsets[b];
+	}
+	auto grouped = std::vector<size_t>(n);
+	auto fill = std::vector<uint32_t>(begin(offsets), end(offsets) - 1);
+	for (auto h : hashes)
+		grouped[fill[bucket_of(h)]++] = h;
+
+	// Place the largest buckets first while there is a lot of room. The
+	// order is made with a counting sort by size, descending.
+	auto size_offsets = std::vector<uint32_t>(max_bucket_size + 2);
+	for (size_t b = 0; b != m; ++b)
+		++size_offsets[max_bucket_size - (offsets[b + 1] - offsets[b]) +
+		               1];
+	for (size_t i = 0; i != max_bucket_size + 1; ++i)
+		size_offsets[i + 1] += size_offsets[i];
+	auto order = std::vector<uint32_t>(m);
+	for (size_t b = 0; b != m; ++b) {
+		auto sz = offsets[b + 1] - offsets[b];
+		order[size_offsets[max_bucket_size - sz]++] = b;
+	}
+
+	auto taken = std::vector<bool>(table_size);
+	auto pos = std::vector<size_t>();
+	auto max_pilot = size_t(1) << 16;
+	for (auto b : order) {
+		auto first = begin(grouped) + offsets[b];
+		auto last = begin(grouped) + offsets[b + 1];
+		if (first == last)
+			break;
+		auto found = false;
+		for (size_t pilot = 0; pilot != max_pilot; ++pilot) {
+			pos.clear();
+			for (auto it = first; it != last; ++it) {
+				auto p = position(*it, pilot);
+				if (taken[p] || std::find(begin(pos), end(pos),
+				                          p) != end(pos))
+					break;
+				pos.push_back(p);
+			}
+			if (std::size(pos) != size_t(last - first))
+				continue;
+			for (auto p : pos)
+				taken[p] = true;
+			pilots[b] = pilot;
+			found = true;
+			break;
+		}
+		if (!found)
+			return false;
+	}
+
+	remap.assign(table_size - n, 0);
+	auto free_pos = size_t(0);
+	for (auto p = n; p != table_size; ++p) {
+		if (!taken[p])
+			continue;
+		while (taken[free_pos])
+			++free_pos;
+		remap[p - n] = free_pos++;
+	}
+	return true;
+}
+
 template <class Key, class T>
 class Hash_Multimap {
 	using bucket_type = std::forward_list<std::pair<Key, T>>;
@@ -528,6 +755,26 @@ class Hash_Multimap {
 	std::vector<bucket_type> data;
 	size_t sz = 0;
 	size_t max_load_factor_capacity = 0;
+	Hash_Filter filter;
+	// Positions instead of iterators, so copies of the map stay valid.
+	struct Key_Run {
+		uint32_t bucket = 0;
+		uint32_t offset = 0; // of the first entry in the bucket
+		uint32_t count = 0;
+		uint32_t fingerprint = 0;
+	};
+	Perfect_Hash perfect_hash;
+	std::vector<Key_Run> runs;
+
+	static auto fingerprint(size_t hash) -> uint32_t
+	{
+		return uint32_t(hash) ^ uint32_t(uint64_t(hash) >> 32);
+	}
+	auto clear_perfect_hash() -> void
+	{
+		perfect_hash.clear();
+		runs.clear();
+	}
 
       public:
 	using key_type = Key;
@@ -559,6 +806,7 @@ class Hash_Multimap {
 			    std::ceil(capacity * max_load_fact);
 			return;
 		}
+		clear_perfect_hash();
 		if (count < size() / max_load_fact)
 			count = size() / max_load_fact;
 		auto n = Hash_Multimap();
@@ -583,10 +831,13 @@ class Hash_Multimap {
 	    -> std::pair<bucket_type&, local_iterator>
 	{
 		auto hash = hasher();
+		clear_perfect_hash();
 		if (sz == max_load_factor_capacity) {
 			reserve(sz + 1);
 		}
 		auto h = hash(key);
+		if (!filter.empty())
+			filter.insert(h);
 		auto h_mod = h & (data.size() - 1);
 		auto& bucket = data[h_mod];
 		auto prev = bucket.before_begin();
@@ -630,6 +881,17 @@ class Hash_Multimap {
 		if (data.empty())
 			return {};
 		auto h = hash(key);
+		if (!filter.may_contain(h))
+			return {};
+		if (!runs.empty()) {
+			auto& r = runs[perfect_hash(h)];
+			if (r.fingerprint != fingerprint(h))
+				return {};
+			auto first = next(begin(data[r.bucket]), r.offset);
+			if (first->first != key)
+				return {};
+			return {first, next(first, r.count)};
+		}
 		auto h_mod = h & (data.size() - 1);
 		auto& bucket = data[h_mod];
 		auto eq_key = [&](auto& x) { return key == x.first; };
@@ -640,6 +902,71 @@ class Hash_Multimap {
 		return {first, last};
 	}
 
+	/**
+	 * @brief Builds a membership filter over the current keys.
+	 *
+	 * After this, equal_range() first asks the filter and for most keys
+	 * that are not in the map it returns without touching the buckets.
+	 * Keys inserted later are added to the filter too.
+	 */
+	auto build_filter() -> void
+	{
+		auto hash = hasher();
+		filter.reset(sz);
+		for (auto& b : data)
+			for (auto& x : b)
+				filter.insert(hash(x.first));
+	}
+	auto has_filter() const { return !filter.empty(); }
+
+	/**
+	 * @brief Builds a minimal perfect hash function over the current keys.
+	 *
+	 * After this, equal_range() finds the entries of a key with one lookup
+	 * in a table that has one slot per distinct key. The slot holds the
+	 * position of the run of entries with that key and a fingerprint of
+	 * its hash, so for most missing keys no key is compared. Any insertion
+	 * drops the function and equal_range() searches the buckets again.
+	 *
+	 * @return true if the function was built.
+	 */
+	auto build_perfect_hash() -> bool
+	{
+		auto hash = hasher();
+		auto hashes = std::vector<size_t>();
+		auto new_runs = std::vector<Key_Run>();
+		clear_perfect_hash();
+		if (data.size() > UINT32_MAX)
+			return false;
+		for (size_t i = 0; i != data.size(); ++i) {
+			auto& b = data[i];
+			auto offset = uint32_t(0);
+			auto it = begin(b);
+			while (it != end(b)) {
+				auto& key = it->first;
+				auto other_key = [&](auto& x) {
+					return x.first != key;
+				};
+				auto last =
+				    std::find_if(next(it), end(b), other_key);
+				auto h = hash(key);
+				auto count = uint32_t(distance(it, last));
+				hashes.push_back(h);
+				new_runs.push_back({uint32_t(i), offset, count,
+				                    fingerprint(h)});
+				offset += count;
+				it = last;
+			}
+		}
+		if (!perfect_hash.build(hashes))
+			return false;
+		runs.resize(std::size(new_runs));
+		for (size_t i = 0; i != std::size(hashes); ++i)
+			runs[perfect_hash(hashes[i])] = new_runs[i];
+		return true;
+	}
+	auto has_perfect_hash() const { return !runs.empty(); }
+
 	auto bucket_count() const -> size_type { return data.size(); }
 	auto bucket_data(size_type i) const { return Subrange(data[i]); }
 };
@@ -651,15 +978,60 @@ struct Condition_Exception : public std::runtime_error {
 /**
  * @internal
  * @brief Minimal regex used as the condition in affix entries.
+ *
+ * The condition is compiled into one character class per code point. ASCII
+ * membership is a bitmap lookup, other code points are searched in a sorted
+ * list of ranges.
  */
 class Condition {
 	using Str = std::string;
 	using Str_View = std::string_view;
 
+	struct Range {
+		char32_t first;
+		char32_t last;
+	};
+	struct Char_Class {
+		uint64_t ascii[2] = {};
+		uint32_t first_range = 0;
+		uint32_t last_range = 0;
+		bool negated = false;
+	};
+
 	Str cond;
 	size_t num_cp = 0;
+	std::vector<Char_Class> classes;
+	std::vector<Range> ranges;
+	bool matches_any = true;
 
 	auto construct() -> void;
+	auto add_class(std::u32string& cps, bool negated) -> void;
+	auto class_contains(const Char_Class& c, char32_t cp) const -> bool
+	{
+		if (cp < 128)
+			return (c.ascii[cp >> 6] >> (cp & 63)) & 1;
+		auto first = begin(ranges) + c.first_range;
+		auto last = begin(ranges) + c.last_range;
+		auto it = std::upper_bound(
+		    first, last, cp,
+		    [](char32_t x, const Range& r) { return x < r.first; });
+		auto found = it != first && cp <= std::prev(it)->last;
+		return found != c.negated;
+	}
+	auto has_num_cp(Str_View s) const -> bool
+	{
+		if (size(s) < num_cp)
+			return false;
+		if (size(s) >= num_cp * 4)
+			return true;
+		auto i = size_t(0);
+		for (size_t n = 0; n != num_cp; ++n) {
+			if (i == size(s))
+				return false;
+			valid_u8_advance_index(s, i);
+		}
+		return true;
+	}
 
       public:
 	Condition() = default;
@@ -678,51 +1050,72 @@ class Condition {
 	auto& operator=(const Str& condition)
 	{
 		cond = condition;
-		num_cp = 0;
 		construct();
 		return *this;
 	}
 	auto& operator=(Str&& condition)
 	{
 		cond = std::move(condition);
-		num_cp = 0;
 		construct();
 		return *this;
 	}
 	auto& operator=(const char* condition)
 	{
 		cond = condition;
-		num_cp = 0;
 		construct();
 		return *this;
 	}
 	auto& str() const { return cond; }
 	auto match_prefix(Str_View s) const -> bool;
-	auto match_suffix(Str_View s) const
-	{
-		auto cp_cnt = size_t(0);
-		auto i = size(s);
-		for (; cp_cnt != num_cp && i != 0; ++cp_cnt) {
-			valid_u8_reverse_index(s, i);
+	auto match_suffix(Str_View s) const -> bool;
+};
+auto inline Condition::add_class(std::u32string& cps, bool negated) -> void
+{
+	auto& c = classes.emplace_back();
+	c.negated = negated;
+	std::sort(begin(cps), end(cps));
+	c.first_range = ranges.size();
+	for (auto cp : cps) {
+		if (cp < 128) {
+			c.ascii[cp >> 6] |= uint64_t(1) << (cp & 63);
+			continue;
 		}
-		if (cp_cnt != num_cp)
-			return false;
-		return match_prefix(s.substr(i));
+		if (ranges.size() != c.first_range &&
+		    ranges.back().last >= cp - 1)
+			ranges.back().last = cp;
+		else
+			ranges.push_back({cp, cp});
 	}
-};
+	c.last_range = ranges.size();
+	if (negated) {
+		c.ascii[0] = ~c.ascii[0];
+		c.ascii[1] = ~c.ascii[1];
+	}
+}
+
 auto inline Condition::construct() -> void
 {
+	num_cp = 0;
+	classes.clear();
+	ranges.clear();
+	matches_any = true;
+	auto cps = std::u32string();
 	for (size_t i = 0; i != size(cond);) {
 		size_t j = cond.find_first_of("[].", i);
 		if (j == cond.npos)
 			j = size(cond);
 		while (i != j) {
-			valid_u8_advance_index(cond, i);
+			char32_t cp;
+			valid_u8_advance_cp(cond, i, cp);
+			cps.assign(1, cp);
+			add_class(cps, false);
 			++num_cp;
 		}
 		if (i == size(cond))
 			break;
 		if (cond[i] == '.') {
+			cps.clear();
+			add_class(cps, true);
 			++num_cp;
 			++i;
 			continue;
@@ -739,7 +1132,8 @@ auto inline Condition::construct() -> void
 				            "closing bracket";
 				throw Condition_Exception(what);
 			}
-			if (cond[i] == '^')
+			auto negated = cond[i] == '^';
+			if (negated)
 				++i;
 			j = cond.find(']', i);
 			if (j == i) {
@@ -751,53 +1145,59 @@ auto inline Condition::construct() -> void
 				            "closing bracket";
 				throw Condition_Exception(what);
 			}
+			cps.clear();
+			while (i != j) {
+				char32_t cp;
+				valid_u8_advance_cp(cond, i, cp);
+				cps.push_back(cp);
+			}
+			add_class(cps, negated);
 			++num_cp;
 			i = j + 1;
 		}
 	}
+	// Only dots (or nothing at all). The bitmaps are not needed, just the
+	// length of the string has to be checked.
+	matches_any = std::all_of(begin(classes), end(classes), [](auto& c) {
+		return c.negated && c.first_range == c.last_range &&
+		       c.ascii[0] == uint64_t(-1) && c.ascii[1] == uint64_t(-1);
+	});
 }
 
 auto inline Condition::match_prefix(Str_View s) const -> bool
 {
+	if (matches_any)
+		return has_num_cp(s);
 	if (size(s) < num_cp)
 		return false;
+	auto i = size_t(0);
+	for (auto& c : classes) {
+		if (i == size(s))
+			return false;
+		char32_t cp;
+		valid_u8_advance_cp(s, i, cp);
+		if (!class_contains(c, cp))
+			return false;
+	}
+	return true;
+}
 
-	auto s_i = size_t(0);
-	auto cond_i = size_t(0);
-	for (; s_i != size(s) && cond_i != size(cond); ++cond_i) {
-		auto s_cu = s[s_i];
-		auto cond_cu = cond[cond_i];
-		switch (cond_cu) {
-		default:
-			if (s_cu != cond_cu)
-				return false;
-			++s_i;
-			break;
-		case '.':
-			valid_u8_advance_index(s, s_i);
-			break;
-		case '[':
-			++cond_i;
-			cond_cu = cond[cond_i];
-			if (cond_cu == '^')
-				++cond_i;
-			char32_t str_cp;
-			valid_u8_advance_cp(s, s_i, str_cp);
-			auto found = false;
-			while (cond[cond_i] != ']') {
-				char32_t cond_cp;
-				valid_u8_advance_cp(cond, cond_i, cond_cp);
-				if (str_cp == cond_cp)
-					found = true;
-			}
-			if (cond_cu != '^' && !found)
-				return false;
-			if (cond_cu == '^' && found)
-				return false;
-			break;
-		}
+auto inline Condition::match_suffix(Str_View s) const -> bool
+{
+	if (matches_any)
+		return has_num_cp(s);
+	if (size(s) < num_cp)
+		return false;
+	auto i = size(s);
+	for (auto c = rbegin(classes); c != rend(classes); ++c) {
+		if (i == 0)
+			return false;
+		char32_t cp;
+		valid_u8_reverse_cp(s, i, cp);
+		if (!class_contains(*c, cp))
+			return false;
 	}
-	return cond_i == size(cond);
+	return true;
 }
 
 struct Prefix {
@@ -874,6 +1274,214 @@ struct Suffix {
 	}
 };
 
+/**
+ * @internal
+ * @brief Immutable trie built over a sorted table of keys.
+ *
+ * Each node keeps the range of table entries whose key is equal to the path
+ * from the root to the node. Because the table is sorted, such entries are
+ * contiguous. The outgoing edges of a node are stored next to each other.
+ */
+template <class CharT>
+class Static_Trie {
+      public:
+	using Char_Type = CharT;
+	using Traits = std::char_traits<CharT>;
+	using Index = uint32_t;
+	static constexpr Index npos = -1;
+
+      private:
+	struct Node {
+		Index first_edge = 0;
+		Index last_edge = 0;
+		Index first_value = 0;
+		Index last_value = 0;
+	};
+	std::vector<Node> nodes;
+	std::basic_string<CharT> edge_labels;
+	std::vector<Index> edge_targets;
+
+	template <class It, class Key_Func>
+	auto build_node(Index node, It table_first, It first, It last,
+	                size_t depth, Key_Func& get_key) -> void
+	{
+		auto key_ends_here = [&](auto& x) {
+			return get_key(x).size() == depth;
+		};
+		auto it = std::find_if_not(first, last, key_ends_here);
+		nodes[node].first_value = first - table_first;
+		nodes[node].last_value = it - table_first;
+
+		auto first_edge = Index(edge_labels.size());
+		auto children = it;
+		while (it != last) {
+			auto c = get_key(*it)[depth];
+			edge_labels.push_back(c);
+			edge_targets.push_back(npos);
+			it = std::find_if(it, last, [&](auto& x) {
+				return !Traits::eq(get_key(x)[depth], c);
+			});
+		}
+		auto last_edge = Index(edge_labels.size());
+		nodes[node].first_edge = first_edge;
+		nodes[node].last_edge = last_edge;
+
+		for (auto e = first_edge; e != last_edge; ++e) {
+			auto c = edge_labels[e];
+			auto children_last =
+			    std::find_if(children, last, [&](auto& x) {
+				    return !Traits::eq(get_key(x)[depth], c);
+			    });
+			auto child = Index(nodes.size());
+			nodes.emplace_back();
+			edge_targets[e] = child;
+			build_node(child, table_first, children, children_last,
+			           depth + 1, get_key);
+			children = children_last;
+		}
+	}
+
+      public:
+	/**
+	 * @brief Builds the trie from a range sorted by key.
+	 * @param first begin of the sorted table.
+	 * @param last end of the sorted table.
+	 * @param get_key function that returns the key of a table entry.
+	 */
+	template <class It, class Key_Func>
+	auto build(It first, It last, Key_Func get_key) -> void
+	{
+		clear();
+		nodes.emplace_back();
+		build_node(0, first, first, last, 0, get_key);
+	}
+	auto clear() -> void
+	{
+		nodes.clear();
+		edge_labels.clear();
+		edge_targets.clear();
+	}
+	auto empty() const { return nodes.empty(); }
+	auto root() const -> Index { return empty() ? npos : 0; }
+	auto child(Index node, Char_Type c) const -> Index
+	{
+		auto& n = nodes[node];
+		for (auto e = n.first_edge; e != n.last_edge; ++e)
+			if (Traits::eq(edge_labels[e], c))
+				return edge_targets[e];
+		return npos;
+	}
+	template <class Func>
+	auto for_each_child(Index node, Func func) const -> void
+	{
+		auto& n = nodes[node];
+		for (auto e = n.first_edge; e != n.last_edge; ++e)
+			func(edge_labels[e], edge_targets[e]);
+	}
+	auto has_children(Index node) const
+	{
+		return nodes[node].first_edge != nodes[node].last_edge;
+	}
+	auto has_values(Index node) const
+	{
+		return nodes[node].first_value != nodes[node].last_value;
+	}
+	auto values(Index node) const -> std::pair<size_t, size_t>
+	{
+		return {nodes[node].first_value, nodes[node].last_value};
+	}
+};
+
+/**
+ * @internal
+ * @brief Aho-Corasick automaton that finds all occurrences of many keys.
+ *
+ * It is a Static_Trie with failure links. One pass over a text finds every
+ * occurrence of every key, including overlapping ones.
+ */
+class Substring_Automaton {
+	using Index = Static_Trie<char>::Index;
+	static constexpr auto npos = Static_Trie<char>::npos;
+	Static_Trie<char> trie;
+	std::vector<Index> fail;
+	std::vector<Index> dict_link; // next node on the fail chain with values
+	std::vector<Index> depth;
+
+      public:
+	/**
+	 * @brief Builds the automaton from a range sorted by key.
+	 * @param first begin of the sorted table.
+	 * @param last end of the sorted table.
+	 * @param get_key function that returns the key of a table entry.
+	 */
+	template <class It, class Key_Func>
+	auto build(It first, It last, Key_Func get_key) -> void
+	{
+		trie.build(first, last, get_key);
+		fail.clear();
+		dict_link.clear();
+		depth.clear();
+		if (first == last)
+			return;
+		// failure links are computed in BFS order
+		auto bfs = std::vector<Index>{trie.root()};
+		for (size_t i = 0; i != bfs.size(); ++i)
+			trie.for_each_child(bfs[i], [&](char, Index child) {
+				bfs.push_back(child);
+			});
+		fail.assign(bfs.size(), trie.root());
+		dict_link.assign(bfs.size(), npos);
+		depth.assign(bfs.size(), 0);
+		for (auto node : bfs) {
+			trie.for_each_child(node, [&](char c, Index child) {
+				depth[child] = depth[node] + 1;
+				if (node == trie.root())
+					return;
+				auto f = fail[node];
+				while (f != trie.root() &&
+				       trie.child(f, c) == npos)
+					f = fail[f];
+				auto fc = trie.child(f, c);
+				fail[child] = fc != npos ? fc : trie.root();
+				auto fl = fail[child];
+				dict_link[child] =
+				    trie.has_values(fl) ? fl : dict_link[fl];
+			});
+		}
+	}
+	auto empty() const { return fail.empty(); }
+
+	/**
+	 * @brief Calls a function for every occurrence of a key in a text.
+	 *
+	 * The function gets the range of table entries that were used when
+	 * building and the position where the key starts in the text.
+	 * Occurrences are reported in the order of their end position.
+	 */
+	template <class Func>
+	auto for_each_match(std::string_view text, Func func) const -> void
+	{
+		if (empty())
+			return;
+		auto root = trie.root();
+		auto node = root;
+		for (size_t i = 0; i != size(text); ++i) {
+			auto c = text[i];
+			auto next = trie.child(node, c);
+			while (next == npos && node != root) {
+				node = fail[node];
+				next = trie.child(node, c);
+			}
+			node = next != npos ? next : root;
+			auto n = trie.has_values(node) ? node : dict_link[node];
+			for (; n != npos; n = dict_link[n]) {
+				auto [f, l] = trie.values(n);
+				func(f, l, i + 1 - depth[n]);
+			}
+		}
+	}
+};
+
 template <class T, class Key_Extr = identity, class Key_Transform = identity>
 class Prefix_Multiset {
       public:
@@ -894,6 +1502,7 @@ class Prefix_Multiset {
 	} ebo;
 	std::basic_string<Char_Type> first_letter;
 	std::vector<size_t> prefix_idx_with_first_letter;
+	Static_Trie<Char_Type> trie;
 
 	auto key_extractor() const -> const Ebo_Key_Extr& { return ebo; }
 	auto key_transformator() const -> const Ebo_Key_Transf& { return ebo; }
@@ -931,6 +1540,10 @@ class Prefix_Multiset {
 		}
 		if (!prefix_idx_with_first_letter.empty())
 			prefix_idx_with_first_letter.push_back(last - first);
+
+		trie.build(first, last, [&](const T& x) -> decltype(auto) {
+			return transform_key(extract_key(x));
+		});
 	}
 
 	struct Comparator {
@@ -1004,13 +1617,25 @@ class Prefix_Multiset {
 	}
 
 	class Iter_Prefixes_Of {
+		using Trie_Index = typename Static_Trie<Char_Type>::Index;
+		static constexpr auto npos = Static_Trie<Char_Type>::npos;
+
 		const Prefix_Multiset* set = {};
 		Iterator it = {};
 		Iterator last = {};
 		const Key_Type* search_key = {};
 		size_t len = {};
+		Trie_Index node = npos;
 		bool valid = false;
 
+		auto enter_node() -> void
+		{
+			auto first = set->get_table().begin();
+			auto [f, l] = set->trie.values(node);
+			it = first + f;
+			last = first + l;
+		}
+
 		auto advance() -> void;
 
 	      public:
@@ -1024,10 +1649,12 @@ class Prefix_Multiset {
 		Iter_Prefixes_Of() = default;
 		Iter_Prefixes_Of(const Prefix_Multiset& set,
 		                 const Key_Type& word)
-		    : set(&set), it(set.get_table().begin()),
-		      last(set.get_table().end()), search_key(&word),
-		      valid(true)
+		    : set(&set), search_key(&word), node(set.trie.root()),
+		      valid(node != npos)
 		{
+			if (!valid)
+				return;
+			enter_node();
 			advance();
 		}
 		Iter_Prefixes_Of(const Prefix_Multiset&, Key_Type&&) = delete;
@@ -1073,55 +1700,23 @@ template <class T, class Key_Extr, class Key_Transform>
 auto Prefix_Multiset<T, Key_Extr, Key_Transform>::Iter_Prefixes_Of::advance()
     -> void
 {
-	auto& extract_key = set->key_extractor();
 	auto& transform_key = set->key_transformator();
-	auto& table = set->get_table();
+	auto&& key = transform_key(*search_key);
 
-	if (len == 0) {
-		if (it != last) {
-			if (transform_key(extract_key(*it)).empty())
-				return;
-			if (transform_key(*search_key).empty()) {
-				valid = false;
-				return;
-			}
-
-			auto& first_letter = set->first_letter;
-			auto& prefix_idx_with_first_letter =
-			    set->prefix_idx_with_first_letter;
-			auto idx =
-			    first_letter.find(transform_key(*search_key)[0]);
-			if (idx == first_letter.npos) {
-				valid = false;
-				return;
-			}
-
-			auto first = table.begin();
-			it = first + prefix_idx_with_first_letter[idx];
-			last = first + prefix_idx_with_first_letter[idx + 1];
-			++len;
-		}
-		else {
+	// Walk down the trie one character at a time until a node with
+	// entries is reached. Each node has all entries of one length.
+	while (it == last) {
+		if (len == key.size()) {
 			valid = false;
 			return;
 		}
-	}
-	for (;; ++len) {
-		if (it != last) {
-			if (transform_key(extract_key(*it)).size() == len)
-				return;
-			if (len == transform_key(*search_key).size()) {
-				valid = false;
-				break;
-			}
-		}
-		else {
+		node = set->trie.child(node, key[len]);
+		if (node == npos) {
 			valid = false;
-			break;
+			return;
 		}
-		tie(it, last) =
-		    equal_range(it, last, transform_key(*search_key)[len],
-		                Comparator{len, extract_key, transform_key});
+		++len;
+		enter_node();
 	}
 }
 
@@ -1231,11 +1826,16 @@ class Prefix_Table {
 	using Vector_Type = typename Prefix_Multiset_Type::Vector_Type;
 	Prefix_Multiset_Type table;
 	Flag_Set all_cont_flags;
+	size_t max_appending_sz = 0;
 
 	auto populate()
 	{
-		for (auto& x : table.data())
+		max_appending_sz = 0;
+		for (auto& x : table.data()) {
 			all_cont_flags += x.cont_flags;
+			max_appending_sz =
+			    std::max(max_appending_sz, x.appending.size());
+		}
 	}
 
       public:
@@ -1269,6 +1869,7 @@ class Prefix_Table {
 	{
 		return all_cont_flags.contains(flag);
 	}
+	auto max_appending_size() const { return max_appending_sz; }
 	auto iterate_prefixes_of(const Key_Type& word) const
 	{
 		return table.iterate_prefixes_of(word);
@@ -1283,11 +1884,16 @@ class Suffix_Table {
 	using Vector_Type = typename Suffix_Multiset_Type::Vector_Type;
 	Suffix_Multiset_Type table;
 	Flag_Set all_cont_flags;
+	size_t max_appending_sz = 0;
 
 	auto populate()
 	{
-		for (auto& x : table.data())
+		max_appending_sz = 0;
+		for (auto& x : table.data()) {
 			all_cont_flags += x.cont_flags;
+			max_appending_sz =
+			    std::max(max_appending_sz, x.appending.size());
+		}
 	}
 
       public:
@@ -1321,6 +1927,7 @@ class Suffix_Table {
 	{
 		return all_cont_flags.contains(flag);
 	}
+	auto max_appending_size() const { return max_appending_sz; }
 	auto iterate_suffixes_of(const Key_Type& word) const
 	{
 		return table.iterate_prefixes_of(word);
@@ -1371,6 +1978,56 @@ class String_Pair {
 	auto& str() const { return s; }
 	auto idx() const { return i; }
 };
+/**
+ * @internal
+ * @brief Positions of affixes in a table, grouped by the affix flag.
+ *
+ * For a given flag, the positions come in increasing order. For each affix it
+ * also keeps if it can be the outermost affix of a whole word, as decided by
+ * the predicate given when building.
+ */
+class Affix_Flag_Index {
+	using Pos_Iter = std::vector<size_t>::const_iterator;
+	std::vector<char16_t> flags;
+	std::vector<size_t> positions;
+	std::vector<bool> outer;
+
+      public:
+	template <class Range, class Pred>
+	auto build(const Range& affixes, Pred is_outer) -> void
+	{
+		auto pairs = std::vector<std::pair<char16_t, size_t>>();
+		outer.clear();
+		for (auto& a : affixes) {
+			pairs.emplace_back(a.flag, outer.size());
+			outer.push_back(is_outer(a));
+		}
+		std::sort(pairs.begin(), pairs.end());
+		flags.clear();
+		positions.clear();
+		for (auto& [flag, pos] : pairs) {
+			flags.push_back(flag);
+			positions.push_back(pos);
+		}
+	}
+	auto clear() -> void
+	{
+		flags.clear();
+		positions.clear();
+		outer.clear();
+	}
+	auto empty() const { return positions.empty(); }
+	auto positions_with(char16_t flag) const -> Subrange<Pos_Iter>
+	{
+		auto r = std::equal_range(flags.begin(), flags.end(), flag);
+		auto first = positions.begin();
+		auto f = r.first - flags.begin();
+		auto l = r.second - flags.begin();
+		return {first + f, first + l};
+	}
+	auto is_outer(size_t pos) const -> bool { return outer[pos]; }
+};
+
 struct Compound_Pattern {
 	String_Pair begin_end_chars;
 	std::string replacement;
@@ -1379,11 +2036,39 @@ struct Compound_Pattern {
 	bool match_first_only_unaffixed_or_zero_affixed = false;
 };
 
+/**
+ * @internal
+ * @brief Table of COMPOUNDRULE patterns.
+ *
+ * Besides the patterns, it keeps all rules compiled into one NFA. Its states
+ * are the positions in the rules, and it moves forward on the flags of the
+ * compound parts. A set of states can be advanced one part at a time.
+ */
 class Compound_Rule_Table {
+      public:
+	using State = std::vector<bool>;
+
+      private:
+	struct Rule_Item {
+		char16_t flag = 0;
+		char16_t quantifier = 0; // 0, '?' or '*'
+		bool end = false;        // accepting state after a rule
+	};
+
 	std::vector<std::u16string> rules;
 	Flag_Set all_flags;
+	std::vector<Rule_Item> items;
+	State start;
 
 	auto fill_all_flags() -> void;
+	auto add_closure(size_t i, State& s) const -> void
+	{
+		for (;; ++i) {
+			s[i] = true;
+			if (items[i].end || items[i].quantifier == 0)
+				break;
+		}
+	}
 
       public:
 	Compound_Rule_Table() = default;
@@ -1411,16 +2096,70 @@ class Compound_Rule_Table {
 	}
 	auto empty() const { return rules.empty(); }
 	auto has_any_of_flags(const Flag_Set& f) const -> bool;
-	auto match_any_rule(const std::vector<const Flag_Set*>& data) const
-	    -> bool;
+
+	/**
+	 * @brief Gets the state before the first part of a compound.
+	 */
+	auto start_state() const -> const State& { return start; }
+
+	/**
+	 * @brief Moves the automaton over one part of a compound.
+	 * @param from state before the part.
+	 * @param word_flags flags of the part.
+	 * @param to state after the part.
+	 * @return false if no rule can match anymore, regardless of the next
+	 * parts.
+	 */
+	auto advance(const State& from, const Flag_Set& word_flags,
+	             State& to) const -> bool
+	{
+		to.assign(items.size(), false);
+		auto alive = false;
+		for (size_t i = 0; i != items.size(); ++i) {
+			auto& it = items[i];
+			if (!from[i] || it.end || !word_flags.contains(it.flag))
+				continue;
+			add_closure(it.quantifier == '*' ? i : i + 1, to);
+			alive = true;
+		}
+		return alive;
+	}
+
+	/**
+	 * @brief Checks if the parts seen so far match some rule completely.
+	 */
+	auto is_accepting(const State& s) const -> bool
+	{
+		for (size_t i = 0; i != items.size(); ++i)
+			if (s[i] && items[i].end)
+				return true;
+		return false;
+	}
 };
 auto inline Compound_Rule_Table::fill_all_flags() -> void
 {
+	all_flags.clear();
+	items.clear();
+	auto rule_starts = std::vector<size_t>();
 	for (auto& f : rules) {
 		all_flags += f;
+
+		// Same item splitting as in match_simple_regex().
+		rule_starts.push_back(items.size());
+		for (size_t i = 0; i != size(f);) {
+			auto& it = items.emplace_back();
+			it.flag = f[i++];
+			if (i != size(f) && (f[i] == '?' || f[i] == '*'))
+				it.quantifier = f[i++];
+		}
+		items.emplace_back().end = true;
 	}
 	all_flags.erase(u'?');
 	all_flags.erase(u'*');
+
+	start.assign(items.size(), false);
+	for (auto i : rule_starts)
+		add_closure(i, start);
 }
 
 auto inline Compound_Rule_Table::has_any_of_flags(const Flag_Set& f) const
@@ -1499,22 +2238,6 @@ auto match_simple_regex(const DataRange& data, const PatternRange& pattern,
 	                          end(pattern), eq);
 }
 
-auto inline match_compund_rule(const std::vector<const Flag_Set*>& words_data,
-                               const std::u16string& pattern)
-{
-	return match_simple_regex(
-	    words_data, pattern,
-	    [](const Flag_Set* d, char16_t p) { return d->contains(p); });
-}
-
-auto inline Compound_Rule_Table::match_any_rule(
-    const std::vector<const Flag_Set*>& data) const -> bool
-{
-	return any_of(begin(rules), end(rules), [&](const std::u16string& p) {
-		return match_compund_rule(data, p);
-	});
-}
-
 using List_Strings = std::vector<std::string>;
 
 class Replacement_Table {
@@ -1524,13 +2247,30 @@ class Replacement_Table {
 	using iterator = typename Table_Str::iterator;
 	using const_iterator = typename Table_Str::const_iterator;
 
+	struct Match {
+		size_t idx; // index of the entry in the table
+		size_t pos; // position of the entry's first string in the word
+	};
+
       private:
 	Table_Str table;
 	size_t whole_word_reps_last_idx = 0;
 	size_t start_word_reps_last_idx = 0;
 	size_t end_word_reps_last_idx = 0;
 
+	// Indexes into table, each group sorted by the string that is
+	// searched in a word, and tries or automaton over them.
+	std::vector<size_t> whole_word_idx;
+	std::vector<size_t> start_word_idx;
+	std::vector<size_t> end_word_idx;
+	std::vector<size_t> any_place_idx;
+	Static_Trie<char> whole_word_trie;
+	Static_Trie<char> start_word_trie;
+	Static_Trie<char> end_word_trie;
+	Substring_Automaton any_place_automaton;
+
 	auto order_entries() -> void;
+	auto build_index() -> void;
 
       public:
 	Replacement_Table() = default;
@@ -1575,6 +2315,9 @@ class Replacement_Table {
 	{
 		return {begin(table) + end_word_reps_last_idx, end(table)};
 	}
+	auto& entry(size_t idx) const { return table[idx]; }
+	auto find_matches(std::string_view word, std::vector<Match>& out) const
+	    -> void;
 };
 auto inline Replacement_Table::order_entries() -> void
 {
@@ -1605,6 +2348,105 @@ auto inline Replacement_Table::order_entries() -> void
 	end_word_reps_last_idx = end_word_reps_last - begin(table);
 	for_each(start_word_reps_last, end_word_reps_last,
 	         [](auto& e) { e.first.pop_back(); });
+
+	build_index();
+}
+
+auto inline Replacement_Table::build_index() -> void
+{
+	auto fill = [&](std::vector<size_t>& idx, size_t first, size_t last,
+	                auto get_key) {
+		idx.resize(last - first);
+		for (size_t i = 0; i != size(idx); ++i)
+			idx[i] = first + i;
+		// stable, entries with same key stay in table order
+		std::stable_sort(begin(idx), end(idx), [&](auto a, auto b) {
+			return get_key(a) < get_key(b);
+		});
+	};
+	auto key = [&](size_t i) -> auto& { return table[i].first; };
+	auto rev_key = [&](size_t i) {
+		return Reversed_String_View<char>(table[i].first);
+	};
+	fill(whole_word_idx, 0, whole_word_reps_last_idx, key);
+	whole_word_trie.build(begin(whole_word_idx), end(whole_word_idx), key);
+	fill(start_word_idx, whole_word_reps_last_idx,
+	     start_word_reps_last_idx, key);
+	start_word_trie.build(begin(start_word_idx), end(start_word_idx), key);
+	fill(end_word_idx, start_word_reps_last_idx, end_word_reps_last_idx,
+	     rev_key);
+	end_word_trie.build(begin(end_word_idx), end(end_word_idx), rev_key);
+	fill(any_place_idx, end_word_reps_last_idx, size(table), key);
+	any_place_automaton.build(begin(any_place_idx), end(any_place_idx),
+	                          key);
+}
+
+/**
+ * @internal
+ * @brief Finds all entries that can be applied to a word.
+ *
+ * The order of the matches is the same as when checking the whole word
+ * replacements, the start of word ones, the end of word ones and finally the
+ * any place ones, each group in table order and for each entry at increasing
+ * positions.
+ *
+ * @param word the word.
+ * @param out appends matches to it.
+ */
+auto inline Replacement_Table::find_matches(std::string_view word,
+                                            std::vector<Match>& out) const
+    -> void
+{
+	constexpr auto npos = Static_Trie<char>::npos;
+	if (table.empty())
+		return;
+
+	auto node = whole_word_trie.root();
+	for (size_t i = 0; i != size(word) && node != npos; ++i)
+		node = whole_word_trie.child(node, word[i]);
+	if (node != npos) {
+		auto [f, l] = whole_word_trie.values(node);
+		for (; f != l; ++f)
+			out.push_back({whole_word_idx[f], 0});
+	}
+
+	auto group_first = size(out);
+	node = start_word_trie.root();
+	for (size_t i = 0; node != npos; ++i) {
+		auto [f, l] = start_word_trie.values(node);
+		for (; f != l; ++f)
+			out.push_back({start_word_idx[f], 0});
+		if (i == size(word))
+			break;
+		node = start_word_trie.child(node, word[i]);
+	}
+	auto by_idx = [](const Match& a, const Match& b) {
+		return a.idx < b.idx;
+	};
+	std::sort(begin(out) + group_first, end(out), by_idx);
+
+	group_first = size(out);
+	node = end_word_trie.root();
+	for (size_t i = 0; node != npos; ++i) {
+		auto [f, l] = end_word_trie.values(node);
+		for (; f != l; ++f)
+			out.push_back({end_word_idx[f], size(word) - i});
+		if (i == size(word))
+			break;
+		node = end_word_trie.child(node, word[size(word) - 1 - i]);
+	}
+	std::sort(begin(out) + group_first, end(out), by_idx);
+
+	group_first = size(out);
+	any_place_automaton.for_each_match(
+	    word, [&](size_t f, size_t l, size_t pos) {
+		    for (; f != l; ++f)
+			    out.push_back({any_place_idx[f], pos});
+	    });
+	auto by_idx_pos = [](const Match& a, const Match& b) {
+		return std::tie(a.idx, a.pos) < std::tie(b.idx, b.pos);
+	};
+	std::sort(begin(out) + group_first, end(out), by_idx_pos);
 }
 
 struct Similarity_Group {
@@ -1642,6 +2484,244 @@ auto inline Similarity_Group::parse(const Str& s) -> void
 	}
 }
 
+/**
+ * @internal
+ * @brief Similarity groups from MAP with an index by code point.
+ *
+ * For each code point, the index lists the groups that have it among their
+ * chars or as the first code point of one of their strings. Those are the only
+ * groups that can replace something at a position with that code point.
+ */
+class Similarity_Table {
+	using Table = std::vector<Similarity_Group>;
+	using Idx_Iter = std::vector<size_t>::const_iterator;
+	Table groups;
+	std::vector<size_t> group_indexes;
+	std::unordered_map<char32_t, std::pair<size_t, size_t>> cp_to_groups;
+
+	auto build_index() -> void;
+
+      public:
+	Similarity_Table() = default;
+	explicit Similarity_Table(const Table& v) : groups(v) { build_index(); }
+	explicit Similarity_Table(Table&& v) : groups(std::move(v))
+	{
+		build_index();
+	}
+	auto& operator=(const Table& v)
+	{
+		groups = v;
+		build_index();
+		return *this;
+	}
+	auto& operator=(Table&& v)
+	{
+		groups = std::move(v);
+		build_index();
+		return *this;
+	}
+	auto begin() const { return groups.begin(); }
+	auto end() const { return groups.end(); }
+	auto size() const { return groups.size(); }
+	auto empty() const { return groups.empty(); }
+	auto& operator[](size_t i) const { return groups[i]; }
+
+	/**
+	 * @brief Gets the indexes of the groups relevant for a code point.
+	 *
+	 * The indexes are in increasing order.
+	 */
+	auto groups_with(char32_t cp) const -> Subrange<Idx_Iter>
+	{
+		auto it = cp_to_groups.find(cp);
+		if (it == cp_to_groups.end())
+			return {group_indexes.end(), group_indexes.end()};
+		auto first = group_indexes.begin();
+		return {first + it->second.first, first + it->second.second};
+	}
+};
+auto inline Similarity_Table::build_index() -> void
+{
+	auto pairs = std::vector<std::pair<char32_t, size_t>>();
+	for (size_t g = 0; g != groups.size(); ++g) {
+		auto& e = groups[g];
+		for (size_t i = 0; i != e.chars.size();) {
+			char32_t cp;
+			valid_u8_advance_cp(e.chars, i, cp);
+			pairs.emplace_back(cp, g);
+		}
+		for (auto& str : e.strings) {
+			auto i = size_t(0);
+			char32_t cp;
+			valid_u8_advance_cp(str, i, cp);
+			pairs.emplace_back(cp, g);
+		}
+	}
+	std::sort(pairs.begin(), pairs.end());
+	pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+	group_indexes.clear();
+	cp_to_groups.clear();
+	for (auto it = pairs.begin(); it != pairs.end();) {
+		auto cp = it->first;
+		auto first = group_indexes.size();
+		for (; it != pairs.end() && it->first == cp; ++it)
+			group_indexes.push_back(it->second);
+		auto last = group_indexes.size();
+		cp_to_groups.emplace(cp, std::pair(first, last));
+	}
+}
+
+/**
+ * @internal
+ * @brief Neighbors of each key as given with KEY.
+ *
+ * KEY lists rows of keys separated by '|'. For each code point the table
+ * holds the keys left and right of each of its occurrences, in the order they
+ * appear in the string. ASCII code points are looked up in a flat array, the
+ * rest in a hash map.
+ */
+class Keyboard_Table {
+	using Range = std::pair<size_t, size_t>;
+	std::string neighbors;
+	Range ascii[128] = {};
+	std::unordered_map<char32_t, Range> non_ascii;
+
+	auto build_index(std::string_view kb) -> void;
+
+      public:
+	Keyboard_Table() = default;
+	explicit Keyboard_Table(std::string_view kb) { build_index(kb); }
+	auto& operator=(std::string_view kb)
+	{
+		build_index(kb);
+		return *this;
+	}
+
+	/**
+	 * @brief Gets the neighbors of a key.
+	 * @return UTF-8 string with the neighbors, one after another.
+	 */
+	auto neighbors_of(char32_t cp) const -> std::string_view
+	{
+		auto r = Range();
+		if (cp < 128) {
+			r = ascii[cp];
+		}
+		else {
+			auto it = non_ascii.find(cp);
+			if (it != non_ascii.end())
+				r = it->second;
+		}
+		return std::string_view(neighbors).substr(r.first,
+		                                          r.second - r.first);
+	}
+};
+auto inline Keyboard_Table::build_index(std::string_view kb) -> void
+{
+	auto lists = std::unordered_map<char32_t, std::string>();
+	for (size_t i = 0, next_i = 0; i != kb.size(); i = next_i) {
+		char32_t cp;
+		valid_u8_advance_cp(kb, next_i, cp);
+		auto& l = lists[cp];
+		if (i != 0 && kb[i - 1] != '|') {
+			auto prev_i = valid_u8_prev_index(kb, i);
+			l.append(kb, prev_i, i - prev_i);
+		}
+		if (next_i != kb.size() && kb[next_i] != '|') {
+			auto next2_i = valid_u8_next_index(kb, next_i);
+			l.append(kb, next_i, next2_i - next_i);
+		}
+	}
+	neighbors.clear();
+	std::fill(std::begin(ascii), std::end(ascii), Range());
+	non_ascii.clear();
+	for (auto& [cp, l] : lists) {
+		auto r = Range(neighbors.size(), neighbors.size() + l.size());
+		neighbors += l;
+		if (cp < 128)
+			ascii[cp] = r;
+		else
+			non_ascii.emplace(cp, r);
+	}
+}
+
+/**
+ * @internal
+ * @brief Set of pairs of adjacent code points.
+ *
+ * Besides explicit pairs, it can hold code points that can be followed by
+ * anything or preceded by anything. Pairs of code points below 256 are kept
+ * in a bit matrix, the rest in a hash set.
+ */
+class Bigram_Set {
+	static constexpr char32_t small_lim = 256;
+	std::vector<uint64_t> small;
+	std::unordered_set<uint64_t> large;
+	std::unordered_set<char32_t> any_after;
+	std::unordered_set<char32_t> any_before;
+
+	static auto key(char32_t a, char32_t b)
+	{
+		return uint64_t(a) << 32 | b;
+	}
+
+      public:
+	auto clear() -> void
+	{
+		small.clear();
+		large.clear();
+		any_after.clear();
+		any_before.clear();
+	}
+	auto empty() const -> bool
+	{
+		return small.empty() && large.empty() && any_after.empty() &&
+		       any_before.empty();
+	}
+	auto insert(char32_t a, char32_t b) -> void
+	{
+		if (a < small_lim && b < small_lim) {
+			if (small.empty())
+				small.resize(small_lim * small_lim / 64);
+			auto bit = size_t(a) * small_lim + b;
+			small[bit / 64] |= uint64_t(1) << (bit % 64);
+			return;
+		}
+		large.insert(key(a, b));
+	}
+	/**
+	 * @brief Inserts all pairs of adjacent code points in a string.
+	 */
+	auto insert_bigrams_of(std::string_view str) -> void
+	{
+		if (str.empty())
+			return;
+		auto i = size_t(0);
+		char32_t a;
+		valid_u8_advance_cp(str, i, a);
+		while (i != str.size()) {
+			char32_t b;
+			valid_u8_advance_cp(str, i, b);
+			insert(a, b);
+			a = b;
+		}
+	}
+	auto insert_any_after(char32_t a) -> void { any_after.insert(a); }
+	auto insert_any_before(char32_t b) -> void { any_before.insert(b); }
+	auto contains(char32_t a, char32_t b) const -> bool
+	{
+		if (a < small_lim && b < small_lim && !small.empty()) {
+			auto bit = size_t(a) * small_lim + b;
+			if (small[bit / 64] >> (bit % 64) & 1)
+				return true;
+		}
+		else if (large.count(key(a, b))) {
+			return true;
+		}
+		return any_after.count(a) || any_before.count(b);
+	}
+};
+
 class Phonetic_Table {
 	using Char_Type = char; // not aware of unicode
 	using Str = std::string;
@@ -56,6 +56,7 @@ auto Suggester::suggest_priv(string_view input_word, List_Strings& out) const
 	auto buffer = string();
 	auto casing = classify_casing(word);
 	auto hq_sugs = High_Quality_Sugs();
+	auto checked = Checked_Sugs();
 	switch (casing) {
 	case Casing::SMALL:
 		if (compound_force_uppercase &&
@@ -64,16 +65,16 @@ auto Suggester::suggest_priv(string_view input_word, List_Strings& out) const
 			out.push_back(buffer);
 			return;
 		}
-		hq_sugs |= suggest_low(word, out);
+		hq_sugs |= suggest_low(word, out, &checked);
 		break;
 	case Casing::INIT_CAPITAL:
-		hq_sugs |= suggest_low(word, out);
+		hq_sugs |= suggest_low(word, out, &checked);
 		to_lower(word, icu_locale, buffer);
-		hq_sugs |= suggest_low(buffer, out);
+		hq_sugs |= suggest_low(buffer, out, &checked);
 		break;
 	case Casing::CAMEL:
 	case Casing::PASCAL: {
-		hq_sugs |= suggest_low(word, out);
+		hq_sugs |= suggest_low(word, out, &checked);
 		auto dot_idx = word.find('.');
 		if (dot_idx != word.npos) {
 			auto after_dot = string_view(word).substr(dot_idx + 1);
@@ -89,17 +90,17 @@ auto Suggester::suggest_priv(string_view input_word, List_Strings& out) const
 			to_lower_char_at(buffer, 0, icu_locale);
 			if (spell_priv(buffer))
 				insert_sug_first(buffer, out);
-			hq_sugs |= suggest_low(buffer, out);
+			hq_sugs |= suggest_low(buffer, out, &checked);
 		}
 		to_lower(word, icu_locale, buffer);
 		if (spell_priv(buffer))
 			insert_sug_first(buffer, out);
-		hq_sugs |= suggest_low(buffer, out);
+		hq_sugs |= suggest_low(buffer, out, &checked);
 		if (casing == Casing::PASCAL) {
 			to_title(word, icu_locale, buffer);
 			if (spell_priv(buffer))
 				insert_sug_first(buffer, out);
-			hq_sugs |= suggest_low(buffer, out);
+			hq_sugs |= suggest_low(buffer, out, &checked);
 		}
 		for (auto it = begin(out); it != end(out); ++it) {
 			auto& sug = *it;
@@ -121,9 +122,9 @@ auto Suggester::suggest_priv(string_view input_word, List_Strings& out) const
 		to_lower(word, icu_locale, buffer);
 		if (keepcase_flag != 0 && spell_priv(buffer))
 			insert_sug_first(buffer, out);
-		hq_sugs |= suggest_low(buffer, out);
+		hq_sugs |= suggest_low(buffer, out, &checked);
 		to_title(word, icu_locale, buffer);
-		hq_sugs |= suggest_low(buffer, out);
+		hq_sugs |= suggest_low(buffer, out, &checked);
 		for (auto& sug : out)
 			to_upper(sug, icu_locale, sug);
 		break;
@@ -217,13 +218,13 @@ auto Suggester::suggest_priv(string_view input_word, List_Strings& out) const
 		output_substr_replacer.replace(sug);
 }
 
-auto Suggester::suggest_low(std::string& word, List_Strings& out) const
-    -> High_Quality_Sugs
+auto Suggester::suggest_low(std::string& word, List_Strings& out,
+                            Checked_Sugs* checked) const -> High_Quality_Sugs
 {
 	auto old_size = out.size();
-	uppercase_suggest(word, out);
-	rep_suggest(word, out);
-	map_suggest(word, out);
+	uppercase_suggest(word, out, checked);
+	rep_suggest(word, out, checked);
+	map_suggest(word, out, checked);
 	auto high_quality_sugs =
 	    old_size != out.size() ||
 
@@ -233,88 +234,64 @@ auto Suggester::suggest_low(std::string& word, List_Strings& out) const
 	    // suggestion if it's already correct and achieves the same.
 	    (!empty(similarities) &&
 	     check_word(word, FORBID_BAD_FORCEUCASE, SKIP_HIDDEN_HOMONYM));
-	adjacent_swap_suggest(word, out);
-	distant_swap_suggest(word, out);
-	keyboard_suggest(word, out);
-	extra_char_suggest(word, out);
-	forgotten_char_suggest(word, out);
-	move_char_suggest(word, out);
-	bad_char_suggest(word, out);
-	doubled_two_chars_suggest(word, out);
+	adjacent_swap_suggest(word, out, checked);
+	distant_swap_suggest(word, out, checked);
+	keyboard_suggest(word, out, checked);
+	extra_char_suggest(word, out, checked);
+	forgotten_char_suggest(word, out, checked);
+	move_char_suggest(word, out, checked);
+	bad_char_suggest(word, out, checked);
+	doubled_two_chars_suggest(word, out, checked);
 	two_words_suggest(word, out);
 	return High_Quality_Sugs(high_quality_sugs);
 }
 
-auto Suggester::add_sug_if_correct(std::string& word, List_Strings& out) const
-    -> bool
+auto Suggester::add_sug_if_correct(std::string& word, List_Strings& out,
+                                   Checked_Sugs* checked) const -> bool
 {
+	if (checked) {
+		auto it = checked->find(word);
+		if (it != checked->end()) {
+			if (it->second)
+				out.push_back(word);
+			return it->second;
+		}
+	}
 	auto res = check_word(word, FORBID_BAD_FORCEUCASE, SKIP_HIDDEN_HOMONYM);
-	if (!res)
-		return false;
-	if (res->contains(forbiddenword_flag))
-		return false;
-	if (forbid_warn && res->contains(warn_flag))
-		return false;
-	out.push_back(word);
-	return true;
+	auto correct = res && !res->contains(forbiddenword_flag) &&
+	               !(forbid_warn && res->contains(warn_flag));
+	if (checked)
+		checked->emplace(word, correct);
+	if (correct)
+		out.push_back(word);
+	return correct;
 }
 
-auto Suggester::uppercase_suggest(const std::string& word,
-                                  List_Strings& out) const -> void
+auto Suggester::uppercase_suggest(const std::string& word, List_Strings& out,
+                                  Checked_Sugs* checked) const -> void
 {
 	auto upp = to_upper(word, icu_locale);
-	add_sug_if_correct(upp, out);
+	add_sug_if_correct(upp, out, checked);
 }
 
-auto Suggester::rep_suggest(std::string& word, List_Strings& out) const
-
-    -> void
+auto Suggester::rep_suggest(std::string& word, List_Strings& out,
+                            Checked_Sugs* checked) const -> void
 {
 	auto& reps = replacements;
-	for (auto& r : reps.whole_word_replacements()) {
-		auto& from = r.first;
-		auto& to = r.second;
-		if (word == from) {
-			word = to;
-			try_rep_suggestion(word, out);
-			word = from;
-		}
-	}
-	for (auto& r : reps.start_word_replacements()) {
-		auto& from = r.first;
-		auto& to = r.second;
-		if (begins_with(word, from)) {
-			word.replace(0, from.size(), to);
-			try_rep_suggestion(word, out);
-			word.replace(0, to.size(), from);
-		}
-	}
-	for (auto& r : reps.end_word_replacements()) {
-		auto& from = r.first;
-		auto& to = r.second;
-		if (ends_with(word, from)) {
-			auto pos = word.size() - from.size();
-			word.replace(pos, word.npos, to);
-			try_rep_suggestion(word, out);
-			word.replace(pos, word.npos, from);
-		}
-	}
-	for (auto& r : reps.any_place_replacements()) {
-		auto& from = r.first;
-		auto& to = r.second;
-		for (auto i = word.find(from); i != word.npos;
-		     i = word.find(from, i + 1)) {
-			word.replace(i, from.size(), to);
-			try_rep_suggestion(word, out);
-			word.replace(i, to.size(), from);
-		}
+	auto matches = vector<Replacement_Table::Match>();
+	reps.find_matches(word, matches);
+	for (auto& m : matches) {
+		auto& [from, to] = reps.entry(m.idx);
+		word.replace(m.pos, from.size(), to);
+		try_rep_suggestion(word, out, checked);
+		word.replace(m.pos, to.size(), from);
 	}
 }
 
-auto Suggester::try_rep_suggestion(std::string& word, List_Strings& out) const
-    -> void
+auto Suggester::try_rep_suggestion(std::string& word, List_Strings& out,
+                                   Checked_Sugs* checked) const -> void
 {
-	if (add_sug_if_correct(word, out))
+	if (add_sug_if_correct(word, out, checked))
 		return;
 
 	auto i = size_t(0);
@@ -334,51 +311,15 @@ auto Suggester::try_rep_suggestion(std::string& word, List_Strings& out) const
 auto Checker::is_rep_similar(std::string& word) const -> bool
 {
 	auto& reps = replacements;
-	for (auto& r : reps.whole_word_replacements()) {
-		auto& from = r.first;
-		auto& to = r.second;
-		if (word == from) {
-			word = to;
-			auto ret = check_simple_word(word, SKIP_HIDDEN_HOMONYM);
-			word = from;
-			if (ret)
-				return true;
-		}
-	}
-	for (auto& r : reps.start_word_replacements()) {
-		auto& from = r.first;
-		auto& to = r.second;
-		if (begins_with(word, from)) {
-			word.replace(0, from.size(), to);
-			auto ret = check_simple_word(word, SKIP_HIDDEN_HOMONYM);
-			word.replace(0, to.size(), from);
-			if (ret)
-				return true;
-		}
-	}
-	for (auto& r : reps.end_word_replacements()) {
-		auto& from = r.first;
-		auto& to = r.second;
-		if (ends_with(word, from)) {
-			auto pos = word.size() - from.size();
-			word.replace(pos, word.npos, to);
-			auto ret = check_simple_word(word, SKIP_HIDDEN_HOMONYM);
-			word.replace(pos, word.npos, from);
-			if (ret)
-				return true;
-		}
-	}
-	for (auto& r : reps.any_place_replacements()) {
-		auto& from = r.first;
-		auto& to = r.second;
-		for (auto i = word.find(from); i != word.npos;
-		     i = word.find(from, i + 1)) {
-			word.replace(i, from.size(), to);
-			auto ret = check_simple_word(word, SKIP_HIDDEN_HOMONYM);
-			word.replace(i, to.size(), from);
-			if (ret)
-				return true;
-		}
+	auto matches = vector<Replacement_Table::Match>();
+	reps.find_matches(word, matches);
+	for (auto& m : matches) {
+		auto& [from, to] = reps.entry(m.idx);
+		word.replace(m.pos, from.size(), to);
+		auto ret = check_simple_word(word, SKIP_HIDDEN_HOMONYM);
+		word.replace(m.pos, to.size(), from);
+		if (ret)
+			return true;
 	}
 	return false;
 }
@@ -400,19 +341,86 @@ auto Suggester::max_attempts_for_long_alogs(string_view word) const -> size_t
 	return ret;
 }
 
-auto Suggester::map_suggest(std::string& word, List_Strings& out) const -> void
+auto Suggester::map_suggest(std::string& word, List_Strings& out,
+                            Checked_Sugs* checked) const -> void
 {
 	auto remaining_attempts = max_attempts_for_long_alogs(word);
-	map_suggest(word, out, 0, remaining_attempts);
+	map_suggest(word, out, 0, remaining_attempts, checked);
+}
+
+/**
+ * @internal
+ * @brief Checks if a correct word can start with word[0, len).
+ *
+ * This is a quick test that can give false positives, but never false
+ * negatives. The part of a word that comes from the root is a prefix of the
+ * root, and after it there can be at most two suffix appendings. Before it
+ * there can be one prefix appending. The trie of roots is used to see how far
+ * a root can follow the given prefix.
+ *
+ * It always returns true when the test is not possible, e.g. with compounding
+ * any start of a root could be followed by anything.
+ */
+auto Suggester::can_begin_word(const std::string& word, size_t len) const
+    -> bool
+{
+	if (root_trie.empty() || complex_prefixes || compound_flag ||
+	    compound_begin_flag || compound_middle_flag ||
+	    compound_last_flag || !compound_rules.empty())
+		return true;
+	auto p = word.substr(0, len);
+	auto walk = [&](auto node, size_t i) {
+		for (; i < size(p); ++i) {
+			node = root_trie.child(node, p[i]);
+			if (node == root_trie.npos)
+				break;
+		}
+		return i;
+	};
+	auto max_sfx = suffixes.max_appending_size();
+	if (suffixes.has_continuation_flags())
+		max_sfx *= 2;
+	if (size(p) - walk(root_trie.root(), 0) <= max_sfx)
+		return true;
+	if (size(p) <= prefixes.max_appending_size())
+		return true;
+	// Every prefix appending is shorter than p, so the prefixes of the
+	// whole word are the prefixes of p.
+	for (auto& pe : prefixes.iterate_prefixes_of(word)) {
+		auto node = root_trie.root();
+		for (size_t j = 0; j != size(pe.stripping); ++j) {
+			node = root_trie.child(node, pe.stripping[j]);
+			if (node == root_trie.npos)
+				break;
+		}
+		auto end = size(pe.appending);
+		if (node != root_trie.npos)
+			end = walk(node, end);
+		if (size(p) - end <= max_sfx)
+			return true;
+	}
+	return false;
 }
 
 auto Suggester::map_suggest(std::string& word, List_Strings& out, size_t i,
-                            size_t& remaining_attempts) const -> void
+                            size_t& remaining_attempts,
+                            Checked_Sugs* checked, bool can_begin) const
+    -> void
 {
+	// Branches that can not begin a correct word are not checked, but
+	// they still use up attempts, like without the test.
+	auto map_suggest_at = [&](size_t end) {
+		auto ok = can_begin && can_begin_word(word, end);
+		if (ok)
+			add_sug_if_correct(word, out, checked);
+		map_suggest(word, out, end, remaining_attempts, checked, ok);
+	};
 	for (size_t next_i = i; i != size(word); i = next_i) {
-		valid_u8_advance_index(word, next_i);
+		char32_t cp;
+		valid_u8_advance_cp(word, next_i, cp);
 		auto word_cp = U8_Encoded_CP(word, {i, next_i});
-		for (auto& e : similarities) {
+		for (auto g : similarities.groups_with(cp)) {
+			auto& e = similarities[g];
 			auto j = e.chars.find(word_cp);
 			if (j == word.npos)
 				goto try_find_strings;
@@ -427,9 +435,7 @@ auto Suggester::map_suggest(std::string& word, List_Strings& out, size_t i,
 				auto rep_cp =
 				    string_view(&e.chars[k], next_k - k);
 				word.replace(i, size(word_cp), rep_cp);
-				add_sug_if_correct(word, out);
-				map_suggest(word, out, i + size(rep_cp),
-				            remaining_attempts);
+				map_suggest_at(i + size(rep_cp));
 				word.replace(i, size(rep_cp), word_cp);
 			}
 			for (auto& r : e.strings) {
@@ -437,9 +443,7 @@ auto Suggester::map_suggest(std::string& word, List_Strings& out, size_t i,
 					return;
 				--remaining_attempts;
 				word.replace(i, size(word_cp), r);
-				add_sug_if_correct(word, out);
-				map_suggest(word, out, i + size(r),
-				            remaining_attempts);
+				map_suggest_at(i + size(r));
 				word.replace(i, size(r), word_cp);
 			}
 		try_find_strings:
@@ -455,9 +459,7 @@ auto Suggester::map_suggest(std::string& word, List_Strings& out, size_t i,
 					auto rep_cp = string_view(&e.chars[k],
 					                          next_k - k);
 					word.replace(i, size(f), rep_cp);
-					add_sug_if_correct(word, out);
-					map_suggest(word, out, i + size(rep_cp),
-					            remaining_attempts);
+					map_suggest_at(i + size(rep_cp));
 					word.replace(i, size(rep_cp), f);
 				}
 				for (auto& r : e.strings) {
@@ -467,9 +469,7 @@ auto Suggester::map_suggest(std::string& word, List_Strings& out, size_t i,
 						return;
 					--remaining_attempts;
 					word.replace(i, size(f), r);
-					add_sug_if_correct(word, out);
-					map_suggest(word, out, i + size(r),
-					            remaining_attempts);
+					map_suggest_at(i + size(r));
 					word.replace(i, size(r), f);
 				}
 			}
@@ -477,8 +477,8 @@ auto Suggester::map_suggest(std::string& word, List_Strings& out, size_t i,
 	}
 }
 
-auto Suggester::adjacent_swap_suggest(std::string& word,
-                                      List_Strings& out) const -> void
+auto Suggester::adjacent_swap_suggest(std::string& word, List_Strings& out,
+                                      Checked_Sugs* checked) const -> void
 {
 	if (word.empty())
 		return;
@@ -488,7 +488,7 @@ auto Suggester::adjacent_swap_suggest(std::string& word,
 	for (size_t i3 = i2; i3 != size(word); i1 = i2, i2 = i3) {
 		valid_u8_advance_index(word, i3);
 		i2 = u8_swap_adjacent_cp(word, i1, i2, i3);
-		add_sug_if_correct(word, out);
+		add_sug_if_correct(word, out, checked);
 		i2 = u8_swap_adjacent_cp(word, i1, i2, i3);
 	}
 	i1 = 0;
@@ -506,7 +506,7 @@ auto Suggester::adjacent_swap_suggest(std::string& word,
 		// word has 4 CPs
 		i2 = u8_swap_adjacent_cp(word, i1, i2, i3);
 		i4 = u8_swap_adjacent_cp(word, i3, i4, i5);
-		add_sug_if_correct(word, out);
+		add_sug_if_correct(word, out, checked);
 		i2 = u8_swap_adjacent_cp(word, i1, i2, i3);
 		i4 = u8_swap_adjacent_cp(word, i3, i4, i5);
 		return;
@@ -516,17 +516,17 @@ auto Suggester::adjacent_swap_suggest(std::string& word,
 		// word has 5 CPs
 		i2 = u8_swap_adjacent_cp(word, i1, i2, i3);
 		i5 = u8_swap_adjacent_cp(word, i4, i5, i6);
-		add_sug_if_correct(word, out);
+		add_sug_if_correct(word, out, checked);
 		i2 = u8_swap_adjacent_cp(word, i1, i2, i3); // revert first two
 		i3 = u8_swap_adjacent_cp(word, i2, i3, i4);
-		add_sug_if_correct(word, out);
+		add_sug_if_correct(word, out, checked);
 		i3 = u8_swap_adjacent_cp(word, i2, i3, i4);
 		i5 = u8_swap_adjacent_cp(word, i4, i5, i6);
 	}
 }
 
-auto Suggester::distant_swap_suggest(std::string& word, List_Strings& out) const
-    -> void
+auto Suggester::distant_swap_suggest(std::string& word, List_Strings& out,
+                                     Checked_Sugs* checked) const -> void
 {
 	if (empty(word))
 		return;
@@ -542,83 +542,109 @@ auto Suggester::distant_swap_suggest(std::string& word, List_Strings& out) const
 			--remaining_attempts;
 			auto [new_i2, new_j] =
 			    u8_swap_cp(word, {i1, i2}, {j, j2});
-			add_sug_if_correct(word, out);
+			add_sug_if_correct(word, out, checked);
 			u8_swap_cp(word, {i1, new_i2}, {new_j, j2});
 		}
 	}
 }
 
-auto Suggester::keyboard_suggest(std::string& word, List_Strings& out) const
-    -> void
+auto Suggester::keyboard_suggest(std::string& word, List_Strings& out,
+                                 Checked_Sugs* checked) const -> void
 {
-	auto& kb = keyboard_closeness;
 	for (size_t j = 0, next_j = 0; j != size(word); j = next_j) {
 		char32_t c;
 		valid_u8_advance_cp(word, next_j, c);
 		auto enc_cp = U8_Encoded_CP(word, {j, next_j});
-		auto upp_c = char32_t(u_toupper(c));
+		auto upp_c = c;
+		if (c < 128) {
+			if ('a' <= c && c <= 'z')
+				upp_c = c - 'a' + 'A';
+		}
+		else {
+			upp_c = char32_t(u_toupper(c));
+		}
 		if (upp_c != c) {
 			auto enc_upp_c = U8_Encoded_CP(upp_c);
 			word.replace(j, size(enc_cp), enc_upp_c);
-			add_sug_if_correct(word, out);
+			add_sug_if_correct(word, out, checked);
 			word.replace(j, size(enc_upp_c), enc_cp);
 		}
-		for (auto i = kb.find(enc_cp); i != kb.npos;
-		     i = kb.find(enc_cp, i + size(enc_cp))) {
-			if (i != 0 && kb[i - 1] != '|') {
-				auto prev_i = valid_u8_prev_index(kb, i);
-				auto kb_c = U8_Encoded_CP(kb, {prev_i, i});
-				word.replace(j, size(enc_cp), kb_c);
-				add_sug_if_correct(word, out);
-				word.replace(j, size(kb_c), enc_cp);
-			}
-			auto next_i = i + size(enc_cp);
-			if (next_i != size(kb) && kb[next_i] != '|') {
-				auto next2_i = valid_u8_next_index(kb, next_i);
-				auto kb_c =
-				    U8_Encoded_CP(kb, {next_i, next2_i});
-				word.replace(j, size(enc_cp), kb_c);
-				add_sug_if_correct(word, out);
-				word.replace(j, size(kb_c), enc_cp);
-			}
+		auto kb = keyboard_closeness.neighbors_of(c);
+		for (size_t i = 0, next_i = 0; i != size(kb); i = next_i) {
+			valid_u8_advance_index(kb, next_i);
+			auto kb_c = kb.substr(i, next_i - i);
+			word.replace(j, size(enc_cp), kb_c);
+			add_sug_if_correct(word, out, checked);
+			word.replace(j, size(kb_c), enc_cp);
 		}
 	}
 }
 
-auto Suggester::extra_char_suggest(std::string& word, List_Strings& out) const
-    -> void
+auto Suggester::extra_char_suggest(std::string& word, List_Strings& out,
+                                   Checked_Sugs* checked) const -> void
 {
 	for (size_t i = 0, next_i = 0; i != size(word); i = next_i) {
 		valid_u8_advance_index(word, next_i);
 		auto cp = U8_Encoded_CP(word, {i, next_i});
 		word.erase(i, size(cp));
-		add_sug_if_correct(word, out);
+		add_sug_if_correct(word, out, checked);
 		word.insert(i, cp);
 	}
 }
 
-auto Suggester::forgotten_char_suggest(std::string& word,
-                                       List_Strings& out) const -> void
+/**
+ * @internal
+ * @brief Checks if a code point can replace word[i, j).
+ *
+ * It is checked against the pairs of adjacent code points that can appear in
+ * a correct word. Like can_begin_word(), false positives are possible, false
+ * negatives are not.
+ */
+auto Suggester::can_fit_between(std::string_view word, size_t i, size_t j,
+                                char32_t cp) const -> bool
+{
+	if (bigrams.empty())
+		return true;
+	if (i != 0) {
+		char32_t prev;
+		valid_u8_reverse_cp(word, i, prev);
+		if (!bigrams.contains(prev, cp))
+			return false;
+	}
+	if (j != size(word)) {
+		char32_t next;
+		valid_u8_advance_cp(word, j, next);
+		if (!bigrams.contains(cp, next))
+			return false;
+	}
+	return true;
+}
+
+auto Suggester::forgotten_char_suggest(std::string& word, List_Strings& out,
+                                       Checked_Sugs* checked) const -> void
 {
 	auto remaining_attempts = max_attempts_for_long_alogs(word);
 	for (size_t t = 0, next_t = 0; t != size(try_chars); t = next_t) {
-		valid_u8_advance_index(try_chars, next_t);
+		char32_t t_cp;
+		valid_u8_advance_cp(try_chars, next_t, t_cp);
 		auto cp = string_view(&try_chars[t], next_t - t);
 		for (size_t i = 0;; valid_u8_advance_index(word, i)) {
 			if (remaining_attempts == 0)
 				return;
 			--remaining_attempts;
-			word.insert(i, cp);
-			add_sug_if_correct(word, out);
-			word.erase(i, size(cp));
+			if (can_fit_between(word, i, i, t_cp)) {
+				word.insert(i, cp);
+				add_sug_if_correct(word, out, checked);
+				word.erase(i, size(cp));
+			}
 			if (i == size(word))
 				break;
 		}
 	}
 }
 
-auto Suggester::move_char_suggest(std::string& word, List_Strings& out) const
-    -> void
+auto Suggester::move_char_suggest(std::string& word, List_Strings& out,
+                                  Checked_Sugs* checked) const -> void
 {
 	if (empty(word))
 		return;
@@ -639,7 +665,7 @@ auto Suggester::move_char_suggest(std::string& word, List_Strings& out) const
 			}
 			--remaining_attempts;
 			j2 = u8_swap_adjacent_cp(word, j1, j2, j3);
-			add_sug_if_correct(word, out);
+			add_sug_if_correct(word, out, checked);
 		}
 		// revert word to initial value
 		rotate(begin(word) + i1, end(word) - (i2 - i1), end(word));
@@ -661,15 +687,15 @@ auto Suggester::move_char_suggest(std::string& word, List_Strings& out) const
 			}
 			--remaining_attempts;
 			j2 = u8_swap_adjacent_cp(word, j1, j2, j3);
-			add_sug_if_correct(word, out);
+			add_sug_if_correct(word, out, checked);
 		}
 		// revert word
 		rotate(begin(word), begin(word) + (i3 - i2), begin(word) + i3);
 	}
 }
 
-auto Suggester::bad_char_suggest(std::string& word, List_Strings& out) const
-    -> void
+auto Suggester::bad_char_suggest(std::string& word, List_Strings& out,
+                                 Checked_Sugs* checked) const -> void
 {
 	auto remaining_attempts = max_attempts_for_long_alogs(word);
 	for (size_t t = 0, next_t = 0; t != size(try_chars); t = next_t) {
@@ -685,15 +711,17 @@ auto Suggester::bad_char_suggest(std::string& word, List_Strings& out) const
 			if (remaining_attempts == 0)
 				return;
 			--remaining_attempts;
+			if (!can_fit_between(word, i, next_i, t_cp))
+				continue;
 			word.replace(i, size(w_enc_cp), t_enc_cp);
-			add_sug_if_correct(word, out);
+			add_sug_if_correct(word, out, checked);
 			word.replace(i, size(t_enc_cp), w_enc_cp);
 		}
 	}
 }
 
-auto Suggester::doubled_two_chars_suggest(std::string& word,
-                                          List_Strings& out) const -> void
+auto Suggester::doubled_two_chars_suggest(std::string& word, List_Strings& out,
+                                          Checked_Sugs* checked) const -> void
 {
 	char32_t cp[5];
 	size_t i[5];
@@ -710,7 +738,7 @@ auto Suggester::doubled_two_chars_suggest(std::string& word,
 		valid_u8_advance_cp(word, j, cp[4]);
 		if (cp[0] == cp[2] && cp[1] == cp[3] && cp[0] == cp[4]) {
 			word.erase(i[3], j - i[3]);
-			add_sug_if_correct(word, out);
+			add_sug_if_correct(word, out, checked);
 			word.insert(i[3], word, i[1], i[3] - i[1]);
 		}
 		copy(begin(i) + 1, end(i), begin(i));
@@ -1055,6 +1083,58 @@ auto Suggester::ngram_suggest(const std::string& word_u8,
 	}
 }
 
+/**
+ * @internal
+ * @brief Gets the affixes with any of the given flags.
+ *
+ * Outputs their positions in the table, in table order. Uses the index when
+ * it is available, otherwise scans the table.
+ */
+template <class AffixTable>
+auto Suggester::affix_positions(const Flag_Set& flags, const AffixTable& table,
+                                const Affix_Flag_Index& index,
+                                std::vector<size_t>& out) const -> void
+{
+	out.clear();
+	if (index.empty()) {
+		auto i = size_t(0);
+		for (auto& a : table) {
+			if (cross_valid_inner_outer(flags, a))
+				out.push_back(i);
+			++i;
+		}
+		return;
+	}
+	for (auto f : flags) {
+		auto r = index.positions_with(f);
+		out.insert(end(out), begin(r), end(r));
+	}
+	sort(begin(out), end(out));
+}
+
+/**
+ * @internal
+ * @brief Gets the affixes a word can take as outermost affix.
+ *
+ * Like affix_positions(), but only gives the affixes that can be outermost in
+ * a whole word and are not circumfixes.
+ */
+template <class AffixTable>
+auto Suggester::outer_affix_positions(const Flag_Set& flags,
+                                      const AffixTable& table,
+                                      const Affix_Flag_Index& index,
+                                      std::vector<size_t>& out) const -> void
+{
+	affix_positions(flags, table, index, out);
+	auto not_outer = [&](size_t i) {
+		if (!index.empty())
+			return !index.is_outer(i);
+		auto& a = begin(table)[i];
+		return outer_affix_NOT_valid<FULL_WORD>(a) || is_circumfix(a);
+	};
+	out.erase(remove_if(begin(out), end(out), not_outer), end(out));
+}
+
 auto Suggester::expand_root_word_for_ngram(
     Word_List::const_reference root_entry, std::string_view wrong,
     List_Strings& expanded_list, std::vector<bool>& cross_affix) const -> void
@@ -1068,13 +1148,14 @@ auto Suggester::expand_root_word_for_ngram(
 	}
 	if (flags.empty())
 		return;
-	for (auto& suffix : suffixes) {
-		if (!cross_valid_inner_outer(flags, suffix))
-			continue;
-		if (outer_affix_NOT_valid<FULL_WORD>(suffix))
-			continue;
-		if (is_circumfix(suffix))
-			continue;
+
+	auto sfx_positions = vector<size_t>();
+	auto pfx_positions = vector<size_t>();
+	outer_affix_positions(flags, suffixes, suffix_index, sfx_positions);
+	outer_affix_positions(flags, prefixes, prefix_index, pfx_positions);
+
+	for (auto j : sfx_positions) {
+		auto& suffix = begin(suffixes)[j];
 		// TODO Suffixes marked with needaffix or circumfix should not
 		// be just skipped as we can later add prefix. This is not
 		// handled in hunspell, too.
@@ -1096,14 +1177,9 @@ auto Suggester::expand_root_word_for_ngram(
 		if (!cross_affix[i])
 			continue;
 
-		for (auto& prefix : prefixes) {
+		for (auto j : pfx_positions) {
+			auto& prefix = begin(prefixes)[j];
 			auto& root_sfx = expanded_list[i];
-			if (!cross_valid_inner_outer(flags, prefix))
-				continue;
-			if (outer_affix_NOT_valid<FULL_WORD>(prefix))
-				continue;
-			if (is_circumfix(prefix))
-				continue;
 			if (!begins_with(root_sfx, prefix.stripping))
 				continue;
 			if (!prefix.check_condition(root_sfx))
@@ -1118,13 +1194,8 @@ auto Suggester::expand_root_word_for_ngram(
 		}
 	}
 
-	for (auto& prefix : prefixes) {
-		if (!cross_valid_inner_outer(flags, prefix))
-			continue;
-		if (outer_affix_NOT_valid<FULL_WORD>(prefix))
-			continue;
-		if (is_circumfix(prefix))
-			continue;
+	for (auto j : pfx_positions) {
+		auto& prefix = begin(prefixes)[j];
 		if (!begins_with(root, prefix.stripping))
 			continue;
 		if (!prefix.check_condition(root))
@@ -1138,5 +1209,146 @@ auto Suggester::expand_root_word_for_ngram(
 		expanded_list.push_back(std::move(expanded));
 	}
 }
+
+/**
+ * @internal
+ * @brief Generates the word forms of a dictionary entry.
+ *
+ * The forms are the root, the root with one suffix, with one prefix, and with
+ * both. The prefix and suffix of a pair are allowed either by the root or by
+ * the continuation flags of the other affix. With @p two_level, forms with two
+ * suffixes are generated too. Each form is checked with check_simple_word(),
+ * so only the forms that are accepted and not forbidden are given, without
+ * duplicates.
+ *
+ * @param root the entry in the word list
+ * @param two_level generate forms with two suffixes
+ * @param out the word forms
+ */
+auto Suggester::expand_root_word(Word_List::const_reference root_entry,
+                                 bool two_level, List_Strings& out) const
+    -> void
+{
+	out.clear();
+	auto& [root, flags] = root_entry;
+	if (flags.contains(forbiddenword_flag) ||
+	    flags.contains(compound_onlyin_flag) ||
+	    flags.contains(HIDDEN_HOMONYM_FLAG))
+		return;
+	auto forms = List_Strings();
+	if (!flags.contains(need_affix_flag))
+		forms.push_back(root);
+
+	auto sfx_positions = vector<size_t>();
+	auto pfx_positions = vector<size_t>();
+	auto positions = vector<size_t>();
+	affix_positions(flags, suffixes, suffix_index, sfx_positions);
+	affix_positions(flags, prefixes, prefix_index, pfx_positions);
+	auto apply_suffix = [](const Suffix& e, const string& w, string& out) {
+		if (!ends_with(w, e.stripping))
+			return false;
+		if (!e.check_condition(w))
+			return false;
+		out = e.to_derived_copy(w);
+		return true;
+	};
+	auto apply_prefix = [](const Prefix& e, const string& w, string& out) {
+		if (!begins_with(w, e.stripping))
+			return false;
+		if (!e.check_condition(w))
+			return false;
+		out = e.to_derived_copy(w);
+		return true;
+	};
+	auto root_sfx = string();
+	auto derived = string();
+
+	for (auto j : sfx_positions) {
+		auto& suffix = begin(suffixes)[j];
+		if (affix_NOT_valid<FULL_WORD>(suffix))
+			continue;
+		if (!apply_suffix(suffix, root, root_sfx))
+			continue;
+		if (!suffix.cont_flags.contains(need_affix_flag) &&
+		    !is_circumfix(suffix))
+			forms.push_back(root_sfx);
+
+		if (suffix.cross_product) {
+			// prefixes allowed by the root or by the suffix
+			affix_positions(suffix.cont_flags, prefixes,
+			                prefix_index, positions);
+			positions.insert(end(positions), begin(pfx_positions),
+			                 end(pfx_positions));
+			sort(begin(positions), end(positions));
+			auto last = unique(begin(positions), end(positions));
+			positions.erase(last, end(positions));
+			for (auto k : positions) {
+				auto& prefix = begin(prefixes)[k];
+				if (!prefix.cross_product)
+					continue;
+				if (is_circumfix(prefix) !=
+				    is_circumfix(suffix))
+					continue;
+				if (apply_prefix(prefix, root_sfx, derived))
+					forms.push_back(derived);
+			}
+		}
+
+		if (!two_level || suffix.cont_flags.empty())
+			continue;
+		affix_positions(suffix.cont_flags, suffixes, suffix_index,
+		                positions);
+		for (auto k : positions) {
+			auto& se1 = begin(suffixes)[k];
+			if (outer_affix_NOT_valid<FULL_WORD>(se1))
+				continue;
+			if (is_circumfix(se1) || is_circumfix(suffix))
+				continue;
+			if (apply_suffix(se1, root_sfx, derived))
+				forms.push_back(derived);
+		}
+	}
+
+	for (auto j : pfx_positions) {
+		auto& prefix = begin(prefixes)[j];
+		if (affix_NOT_valid<FULL_WORD>(prefix))
+			continue;
+		if (!prefix.cont_flags.contains(need_affix_flag) &&
+		    !is_circumfix(prefix) &&
+		    apply_prefix(prefix, root, derived))
+			forms.push_back(derived);
+		if (!prefix.cross_product || prefix.cont_flags.empty())
+			continue;
+
+		// suffixes allowed by the prefix, those allowed by the root
+		// are done above
+		affix_positions(prefix.cont_flags, suffixes, suffix_index,
+		                positions);
+		for (auto k : positions) {
+			auto& suffix = begin(suffixes)[k];
+			if (!suffix.cross_product)
+				continue;
+			if (is_circumfix(prefix) != is_circumfix(suffix))
+				continue;
+			if (!apply_suffix(suffix, root, root_sfx))
+				continue;
+			if (apply_prefix(prefix, root_sfx, derived))
+				forms.push_back(derived);
+		}
+	}
+
+	// out does not reallocate, so the views into it stay valid
+	out.reserve(size(forms));
+	auto seen = unordered_set<string_view>();
+	for (auto& f : forms) {
+		if (seen.count(f))
+			continue;
+		auto res = check_simple_word(f, SKIP_HIDDEN_HOMONYM);
+		if (!res || res->contains(forbiddenword_flag))
+			continue;
+		out.push_back(std::move(f));
+		seen.insert(out.back());
+	}
+}
 NUSPELL_END_INLINE_NAMESPACE
 } // namespace nuspell
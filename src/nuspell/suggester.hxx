@@ -30,54 +30,69 @@ struct NUSPELL_EXPORT Suggester : public Checker {
 		ALL_LOW_QUALITY_SUGS = false,
 		HAS_HIGH_QUALITY_SUGS = true
 	};
+	// Candidates already checked, and if they were accepted.
+	using Checked_Sugs = std::unordered_map<std::string, bool>;
 
 	auto suggest_priv(std::string_view input_word, List_Strings& out) const
 	    -> void;
 
-	auto suggest_low(std::string& word, List_Strings& out) const
+	auto suggest_low(std::string& word, List_Strings& out,
+	                 Checked_Sugs* checked = nullptr) const
 	    -> High_Quality_Sugs;
 
-	auto add_sug_if_correct(std::string& word, List_Strings& out) const
-	    -> bool;
+	auto add_sug_if_correct(std::string& word, List_Strings& out,
+	                        Checked_Sugs* checked = nullptr) const -> bool;
 
-	auto uppercase_suggest(const std::string& word, List_Strings& out) const
-	    -> void;
+	auto uppercase_suggest(const std::string& word, List_Strings& out,
+	                       Checked_Sugs* checked = nullptr) const -> void;
 
-	auto rep_suggest(std::string& word, List_Strings& out) const -> void;
+	auto rep_suggest(std::string& word, List_Strings& out,
+	                 Checked_Sugs* checked = nullptr) const -> void;
 
-	auto try_rep_suggestion(std::string& word, List_Strings& out) const
-	    -> void;
+	auto try_rep_suggestion(std::string& word, List_Strings& out,
+	                        Checked_Sugs* checked = nullptr) const -> void;
 
 	auto max_attempts_for_long_alogs(std::string_view word) const -> size_t;
 
-	auto map_suggest(std::string& word, List_Strings& out) const -> void;
+	auto map_suggest(std::string& word, List_Strings& out,
+	                 Checked_Sugs* checked = nullptr) const -> void;
 
+	auto can_begin_word(const std::string& word, size_t len) const
+	    -> bool;
+	auto can_fit_between(std::string_view word, size_t i, size_t j,
+	                     char32_t cp) const -> bool;
 	auto map_suggest(std::string& word, List_Strings& out, size_t i,
-	                 size_t& remaining_attempts) const -> void;
+	                 size_t& remaining_attempts,
+	                 Checked_Sugs* checked = nullptr,
+	                 bool can_begin = true) const -> void;
 
-	auto adjacent_swap_suggest(std::string& word, List_Strings& out) const
+	auto adjacent_swap_suggest(std::string& word, List_Strings& out,
+	                           Checked_Sugs* checked = nullptr) const
 	    -> void;
 
-	auto distant_swap_suggest(std::string& word, List_Strings& out) const
+	auto distant_swap_suggest(std::string& word, List_Strings& out,
+	                          Checked_Sugs* checked = nullptr) const
 	    -> void;
 
-	auto keyboard_suggest(std::string& word, List_Strings& out) const
-	    -> void;
+	auto keyboard_suggest(std::string& word, List_Strings& out,
+	                      Checked_Sugs* checked = nullptr) const -> void;
 
-	auto extra_char_suggest(std::string& word, List_Strings& out) const
-	    -> void;
+	auto extra_char_suggest(std::string& word, List_Strings& out,
+	                        Checked_Sugs* checked = nullptr) const -> void;
 
-	auto forgotten_char_suggest(std::string& word, List_Strings& out) const
+	auto forgotten_char_suggest(std::string& word, List_Strings& out,
+	                            Checked_Sugs* checked = nullptr) const
 	    -> void;
 
-	auto move_char_suggest(std::string& word, List_Strings& out) const
-	    -> void;
+	auto move_char_suggest(std::string& word, List_Strings& out,
+	                       Checked_Sugs* checked = nullptr) const -> void;
 
-	auto bad_char_suggest(std::string& word, List_Strings& out) const
-	    -> void;
+	auto bad_char_suggest(std::string& word, List_Strings& out,
+	                      Checked_Sugs* checked = nullptr) const -> void;
 
-	auto doubled_two_chars_suggest(std::string& word,
-	                               List_Strings& out) const -> void;
+	auto doubled_two_chars_suggest(std::string& word, List_Strings& out,
+	                               Checked_Sugs* checked = nullptr) const
+	    -> void;
 
 	auto two_words_suggest(const std::string& word, List_Strings& out) const
 	    -> void;
@@ -85,11 +100,23 @@ struct NUSPELL_EXPORT Suggester : public Checker {
 	auto ngram_suggest(const std::string& word_u8, List_Strings& out) const
 	    -> void;
 
+	template <class AffixTable>
+	auto affix_positions(const Flag_Set& flags, const AffixTable& table,
+	                     const Affix_Flag_Index& index,
+	                     std::vector<size_t>& out) const -> void;
+	template <class AffixTable>
+	auto outer_affix_positions(const Flag_Set& flags,
+	                           const AffixTable& table,
+	                           const Affix_Flag_Index& index,
+	                           std::vector<size_t>& out) const -> void;
 	auto expand_root_word_for_ngram(Word_List::const_reference root,
 	                                std::string_view wrong,
 	                                List_Strings& expanded_list,
 	                                std::vector<bool>& cross_affix) const
 	    -> void;
+
+	auto expand_root_word(Word_List::const_reference root, bool two_level,
+	                      List_Strings& out) const -> void;
 };
 
 NUSPELL_END_INLINE_NAMESPACE
@@ -28,6 +28,22 @@
 #include <unicode/unistr.h>
 #include <unicode/ustring.h>
 
+#if __has_include(<unistd.h>)
+#include <unistd.h> // defines _POSIX_VERSION
+#endif
+#ifdef _POSIX_VERSION
+#include <sys/resource.h>
+#endif
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include <psapi.h>
+#endif
+
 #if ' ' != 32 || '.' != 46 || 'A' != 65 || 'Z' != 90 || 'a' != 97 || 'z' != 122
 #error "Basic execution character set is not ASCII"
 #endif
@@ -350,6 +366,188 @@ auto Encoding_Converter::to_utf8(string_view in, string& out) -> bool
 	return U_SUCCESS(err);
 }
 
+namespace {
+auto default_char_class(char32_t cp) -> Word_Tokenizer::Char_Class
+{
+	using T = Word_Tokenizer;
+	switch (cp) {
+	case '\'':
+	case 0x2018:
+	case 0x2019:
+	case 0x2024:
+	case 0xFE52:
+	case 0xFF07:
+	case 0xFF0E:
+		return T::MID_NUM_LET;
+	// ICU's root rules do not join letters at colons and full stops
+	case 0x00B7:
+	case 0x0387:
+	case 0x055F:
+	case 0x05F4:
+	case 0x2027:
+	case 0xFE13:
+		return T::MID_LETTER;
+	case ',':
+	case '.':
+	case ';':
+	case 0x037E:
+	case 0x0589:
+	case 0x060C:
+	case 0x060D:
+	case 0x066C:
+	case 0x07F8:
+	case 0x2044:
+	case 0xFE10:
+	case 0xFE14:
+	case 0xFE50:
+	case 0xFE54:
+	case 0xFF0C:
+	case 0xFF1B:
+		return T::MID_NUM;
+	}
+	switch (u_charType(cp)) {
+	case U_UPPERCASE_LETTER:
+	case U_LOWERCASE_LETTER:
+	case U_TITLECASE_LETTER:
+	case U_MODIFIER_LETTER:
+	case U_OTHER_LETTER:
+	case U_LETTER_NUMBER:
+		return T::LETTER;
+	case U_DECIMAL_DIGIT_NUMBER:
+		return T::DIGIT;
+	case U_CONNECTOR_PUNCTUATION:
+		return T::CONNECTOR;
+	case U_NON_SPACING_MARK:
+	case U_ENCLOSING_MARK:
+	case U_COMBINING_SPACING_MARK:
+	case U_FORMAT_CHAR:
+		return T::EXTEND;
+	default:
+		return T::OTHER;
+	}
+}
+
+auto bmp_char_classes() -> const vector<Word_Tokenizer::Char_Class>&
+{
+	static const auto table = [] {
+		auto t = vector<Word_Tokenizer::Char_Class>(0x10000);
+		for (char32_t cp = 0; cp != 0x10000; ++cp)
+			t[cp] = default_char_class(cp);
+		return t;
+	}();
+	return table;
+}
+} // namespace
+
+/**
+ * @internal
+ * @brief Changes the class of one code point.
+ */
+auto Word_Tokenizer::tailor(char32_t cp, Char_Class c) -> void
+{
+	auto& t = tailored;
+	auto it = lower_bound(begin(t), end(t), cp,
+	                      [](auto& x, char32_t y) { return x.first < y; });
+	if (it != end(t) && it->first == cp)
+		it->second = c;
+	else
+		t.emplace(it, cp, c);
+}
+
+auto Word_Tokenizer::classify(char32_t cp) const -> Char_Class
+{
+	auto& t = tailored;
+	if (!t.empty() && cp >= t.front().first && cp <= t.back().first) {
+		auto it = lower_bound(
+		    begin(t), end(t), cp,
+		    [](auto& x, char32_t y) { return x.first < y; });
+		if (it->first == cp)
+			return it->second;
+	}
+	if (cp < 0x10000)
+		return bmp_char_classes()[cp];
+	return default_char_class(cp);
+}
+
+/**
+ * @internal
+ * @brief Calls func for each word in text, in order.
+ *
+ * The words are views into text. Invalid UTF-8 breaks words.
+ */
+auto Word_Tokenizer::for_each_word(
+    std::string_view text,
+    const std::function<void(std::string_view)>& func) const -> void
+{
+	auto& table = bmp_char_classes();
+	// ASCII is looked up in a tailored copy, the rest in the shared table
+	// unless it is tailored.
+	Char_Class ascii[0x80];
+	copy_n(begin(table), 0x80, ascii);
+	for (auto& [cp, c] : tailored)
+		if (cp < 0x80)
+			ascii[cp] = c;
+	auto tailored_non_ascii = !tailored.empty() &&
+	                          tailored.back().first >= 0x80;
+	auto next_class = [&](size_t& i) {
+		auto byte = static_cast<unsigned char>(text[i]);
+		if (byte < 0x80) {
+			++i;
+			return ascii[byte];
+		}
+		int32_t cp;
+		u8_advance_cp(text, i, cp);
+		if (u8_is_cp_error(cp))
+			return OTHER;
+		if (cp < 0x10000 && !tailored_non_ascii)
+			return table[cp];
+		return classify(cp);
+	};
+	auto word_start = text.npos;
+	auto prev = OTHER; // last letter, digit or connector of the word
+	auto has_alnum = false;
+	for (size_t i = 0; i != size(text);) {
+		auto start = i;
+		auto c = next_class(i);
+		if (word_start != text.npos) {
+			if (c == LETTER || c == DIGIT || c == CONNECTOR) {
+				has_alnum = has_alnum || c != CONNECTOR;
+				prev = c;
+				continue;
+			}
+			if (c == EXTEND)
+				continue;
+			if ((c == MID_LETTER || c == MID_NUM ||
+			     c == MID_NUM_LET) &&
+			    i != size(text)) {
+				auto j = i;
+				auto next = next_class(j);
+				// MID_LETTER only between letters, MID_NUM
+				// only between digits
+				auto joins = next == prev &&
+				             (next == LETTER   ? c != MID_NUM
+				              : next == DIGIT ? c != MID_LETTER
+				                              : false);
+				if (joins) {
+					i = j;
+					continue;
+				}
+			}
+			if (has_alnum)
+				func(text.substr(word_start,
+				                 start - word_start));
+			word_start = text.npos;
+		}
+		if (c == LETTER || c == DIGIT || c == CONNECTOR) {
+			word_start = start;
+			prev = c;
+			has_alnum = c != CONNECTOR;
+		}
+	}
+	if (word_start != text.npos && has_alnum)
+		func(text.substr(word_start));
+}
+
 auto replace_ascii_char(string& s, char from, char to) -> void
 {
 	for (auto i = s.find(from); i != s.npos; i = s.find(from, i + 1)) {
@@ -415,5 +613,28 @@ auto count_appereances_of(string_view haystack, string_view needles) -> size_t
 	return ret;
 }
 
+/**
+ * @internal
+ * @brief Returns the peak memory usage of the process in KiB.
+ *
+ * It is the maximum resident set size, or the peak working set on Windows.
+ * Returns 0 if it is not available.
+ */
+auto get_peak_ram_usage() -> long
+{
+#ifdef _POSIX_VERSION
+	rusage r;
+	auto err = getrusage(RUSAGE_SELF, &r);
+	if (!err)
+		return r.ru_maxrss;
+#elif _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	auto suc = GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+	if (suc)
+		return pmc.PeakWorkingSetSize >> 10;
+#endif
+	return 0;
+}
+
 NUSPELL_END_INLINE_NAMESPACE
 } // namespace nuspell
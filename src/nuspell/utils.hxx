@@ -22,6 +22,7 @@
 #include "defines.hxx"
 #include "nuspell_export.h"
 
+#include <functional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -137,11 +138,52 @@ class Encoding_Converter {
 	auto valid() -> bool { return cnv != nullptr; }
 };
 
+/**
+ * @internal
+ * @brief Splits UTF-8 text into words without ICU's break iterator.
+ *
+ * A word is a run of letters and digits, with marks and format characters
+ * inside it. Apostrophes join letters or digits on both sides, middle dots
+ * join letters and periods and commas join digits, like the classes MidNumLet,
+ * MidLetter and MidNum of UAX #29. Words made of connector punctuation only,
+ * like "_", are skipped. Unlike ICU, runs of CJK and Thai letters are not
+ * split by a dictionary.
+ *
+ * The classes of the BMP come from a precomputed table shared by all
+ * tokenizers. The class of single code points can be tailored, which the
+ * dictionary does with WORDCHARS and BREAK. The tailored code points are kept
+ * in a small sorted list that is checked before the table.
+ */
+class Word_Tokenizer {
+      public:
+	enum Char_Class : unsigned char {
+		OTHER,
+		LETTER,
+		DIGIT,
+		CONNECTOR,
+		EXTEND,
+		MID_LETTER,
+		MID_NUM,
+		MID_NUM_LET
+	};
+
+      private:
+	std::vector<std::pair<char32_t, Char_Class>> tailored; // sorted
+
+      public:
+	auto tailor(char32_t cp, Char_Class c) -> void;
+	auto classify(char32_t cp) const -> Char_Class;
+	auto for_each_word(std::string_view text,
+	                   const std::function<void(std::string_view)>& func)
+	    const -> void;
+};
+
 auto replace_ascii_char(std::string& s, char from, char to) -> void;
 auto erase_chars(std::string& s, std::string_view erase_chars) -> void;
 NUSPELL_EXPORT auto is_number(std::string_view s) -> bool;
 auto count_appereances_of(std::string_view haystack, std::string_view needles)
     -> size_t;
+NUSPELL_EXPORT auto get_peak_ram_usage() -> long;
 
 auto inline begins_with(std::string_view haystack, std::string_view needle)
     -> bool
@@ -18,12 +18,27 @@
 
 #include <nuspell/dictionary.hxx>
 #include <nuspell/finder.hxx>
+#include <nuspell/utils.hxx>
 
+#include "server.hxx"
+
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cmath>
 #include <clocale>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_set>
 #include <unicode/brkiter.h>
 #include <unicode/ucnv.h>
 
@@ -33,7 +48,10 @@
 #include <unistd.h> // defines _POSIX_VERSION
 #endif
 #ifdef _POSIX_VERSION
+#include <fcntl.h>
 #include <langinfo.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 #ifdef _WIN32
 #include <io.h>
@@ -50,16 +68,30 @@
 #endif
 
 using namespace std;
-using nuspell::Dictionary, nuspell::Dictionary_Loading_Error,
-    nuspell::Dict_Finder_For_CLI_Tool_2;
+using nuspell::Dictionary, nuspell::Dictionary_Loading_Error;
 namespace {
-enum Mode { NORMAL, HELP, VERSION, LIST_DICTS };
+enum Mode {
+	NORMAL,
+	HELP,
+	VERSION,
+	LIST_DICTS,
+	MISSPELLED_WORDS,
+	MISSPELLED_LINES,
+	UNIQUE_MISSPELLED,
+	SERVER,
+	CLIENT,
+	PIPE
+};
 auto print_help(const char* program_name) -> void
 {
 	auto p = string_view(program_name);
 	auto& o = cout;
 	o << "Usage:\n"
 	  << p << " [-d dict_NAME] [OPTION]... [FILE...]\n"
+	  << p << " [-d dict_NAME] [OPTION]... -r [--include=GLOB]... DIR...\n"
+	  << p << " [-d dict_NAME] [-j N] --server [--socket=PATH]\n"
+	  << p << " --client=PATH\n"
+	  << p << " [-d dict_NAME] -a [--pipe-stats]\n"
 	  << p << " -D|--help|--version\n"
 	  << R"(
 Check spelling of each FILE. If no FILE is specified, check standard input.
@@ -71,6 +103,37 @@ that recognizes punctuation and then each word is checked.
   --encoding=enc            set both input and output encoding
   --input-encoding=enc      input encoding, default is active locale
   --output-encoding=enc     output encoding, default is active locale
+  -j, --jobs=N              check with N threads, default is 1
+  --tokenizer=NAME          split text into words with icu (default) or fast
+  -l, --misspelled-words    print only misspelled words
+  -L, --misspelled-lines    print only lines with misspelled words
+  -U, --unique-misspelled-words
+                            print each distinct misspelled word once, with
+                            the number of times it occurs
+  -r, --recursive           check the files in directories, recursively
+  --include=GLOB            with -r, check only files matching GLOB
+  --exclude=GLOB            with -r, skip files and directories matching GLOB
+  --stats[=FORMAT]          print statistics and timing to standard error at
+                            the end, FORMAT is text (default) or json
+  --dictionary-cache[=FILE] find dictionaries through a cache in FILE, default
+                            is in the user's cache directory
+  --server                  answer JSON requests, one per line, on standard
+                            input and output
+  --socket=PATH             with --server, listen on a Unix socket instead
+  --deadline=MS             with --server, default and maximum deadline of
+                            requests
+  --max-dictionaries=N      with --server, keep at most N dictionaries loaded,
+                            default is 16
+  --max-connections=N       with --socket, serve at most N clients at once,
+                            default is 64
+  --allow-dictionary-paths  with --server, accept paths to dictionaries in
+                            requests, not only names
+  --client=PATH             send standard input to the server on PATH and
+                            print the responses
+  -a                        use the pipe interface of ispell on standard
+                            input and output
+  --pipe-stats              with -a, print the number of requests and their
+                            latency to standard error at the end
   --help                    print this help
   --version                 print version number
 
@@ -82,9 +145,63 @@ the default directories (see option -D). When a path to .aff is given, only the
 dictionary under the path is considered. When -d is not present, the CLI tools
 tries to load a dictionary using the language tag from the active locale.
 
+With --dictionary-cache, the dictionaries found in each directory are stored in
+a cache file, and the next time only the modification times of the directories
+are checked instead of their contents. This helps when the directories are on
+slow network file systems. It is used by -d and -D.
+
+The fast tokenizer splits at the same places as ICU in most text, but keeps
+hyphenated words and other words joined by WORDCHARS whole and does not split
+Chinese, Japanese or Thai text into words.
+
+The options -l, -L and -U do not compute suggestions. With -U, the misspelled
+words of all the input are printed at the end, in the order they first appear,
+each followed by a tab and the count.
+
+With more than one thread the input is read in blocks of lines that are
+checked in parallel. The output is the same as with one thread, but it is
+written only after a whole block is checked. When there are multiple files,
+the files are checked in parallel instead, each by one thread.
+
+With multiple files or -r, the output of each file is preceded by the line
+"==> FILE <==", files without output get no such line. The output is in the
+order of the arguments, and the files in directories are sorted by name.
+The patterns of --include and --exclude can be given multiple times and are
+matched against the name of the file or directory without its path, using
+*, ? and [...] as in the shell. Symbolic links to directories are not
+followed. A summary of the checked files, words, misspelled words and the
+throughput is printed to standard error at the end.
+
+With --stats, the latency of each spell and suggest call is measured too. The
+statistics are the load time of the dictionary, the check time and words per
+second, the peak memory use, the time spent in spell and in suggest with
+latency percentiles and histograms, and with -U the ratio of repeated words
+that were not checked again. The percentiles are upper bounds of buckets that
+are powers of two in nanoseconds. The JSON format is one object on one line.
+
+With -a the tool speaks the pipe protocol of ispell and Hunspell, used by
+editors. A correct word gets *, a misspelled one gets "& word count offset:
+suggestions" or "# word offset" when there are no suggestions. Offsets are in
+characters from the start of the line. The lines starting with ! % * & @ # ^
+are commands as in ispell. Words added with * & or @ are accepted until exit,
+& adds the word in lowercase. A word added in lowercase is also accepted in
+title case and upper case, other words also in upper case. Unlike in Hunspell,
+the words are not saved and * does not take a model word after a slash.
+
+In server mode the dictionaries stay loaded and -j sets the number of worker
+threads. Each request is a JSON object on one line, for example
+  {"id":1,"cmd":"spell","word":"hello"}
+  {"id":2,"cmd":"suggest","word":"helo","dictionary":"de_DE"}
+  {"id":3,"cmd":"check","words":["a","b"],"suggest":false,"deadline_ms":50}
+and gets one response line with the same id. Responses can come in a different
+order than the requests. Other dictionaries are loaded on first use, they are
+searched by name like with -d, but paths are refused unless allowed. The socket
+can be used only by the user that runs the server and is removed when the
+server is stopped with SIGINT or SIGTERM.
+
 Returns error if the argument syntax is invalid, if the dictionary can not be
-loaded or if some input file can not be opened. Otherwise, spell checking has
-occurred and returns success.
+loaded or if some input file or directory can not be opened. The other files
+are still checked. Otherwise, spell checking has occurred and returns success.
 
 The following environment variables can have effect:
 
@@ -95,6 +212,7 @@ Example:
 )"
 	  << "    " << p << " -d en_US file.txt\n"
 	  << "    " << p << " -d ../../subdir/di_CT.aff\n"
+	  << "    " << p << " -d en_US -l -j 4 -r --include='*.md' docs\n"
 	  << R"(
 Bug reports: <https://github.com/nuspell/nuspell/issues>
 Full documentation: <https://github.com/nuspell/nuspell/wiki>
@@ -113,7 +231,7 @@ Written by Dimitrij Mijoski.
 
 auto print_version() -> void { cout << ver_str; }
 
-auto list_dictionaries(const Dict_Finder_For_CLI_Tool_2& f) -> void
+auto list_dictionaries(const CLI_Dict_Finder& f) -> void
 {
 	if (empty(f.get_dir_paths())) {
 		cout << "No search paths available" << '\n';
@@ -124,8 +242,7 @@ auto list_dictionaries(const Dict_Finder_For_CLI_Tool_2& f) -> void
 			cout << p.string() << '\n';
 		}
 	}
-	auto dicts = vector<filesystem::path>();
-	nuspell::search_dirs_for_dicts(f.get_dir_paths(), dicts);
+	auto dicts = f.get_dictionaries();
 	if (empty(dicts)) {
 		cout << "No dictionaries available\n";
 	}
@@ -139,85 +256,160 @@ auto list_dictionaries(const Dict_Finder_For_CLI_Tool_2& f) -> void
 	}
 }
 
-auto from_utf8(string_view source, string& dest, UConverter* ucnv,
-               UErrorCode& uerr)
-{
-	dest.resize(dest.capacity());
-	auto len =
-	    ucnv_fromAlgorithmic(ucnv, UCNV_UTF8, dest.data(), dest.size(),
-	                         source.data(), source.size(), &uerr);
-	dest.resize(len);
-	if (uerr == U_BUFFER_OVERFLOW_ERROR) {
-		uerr = U_ZERO_ERROR;
-		ucnv_fromAlgorithmic(ucnv, UCNV_UTF8, dest.data(), dest.size(),
-		                     source.data(), source.size(), &uerr);
+/**
+ * @brief Converts text between an encoding and UTF-8 in blocks of any size.
+ *
+ * The state of the conversion is kept between the blocks, so a character can
+ * be split between them. A whole block of text is converted with one call to
+ * ICU. The converter is not owned.
+ */
+class Block_Converter {
+	UConverter* cnv;
+	icu::LocalUConverterPointer utf8_cnv;
+	bool to_utf8;
+	UChar pivot[1024];
+	UChar* pivot_source = pivot;
+	UChar* pivot_target = pivot;
+
+      public:
+	Block_Converter(UConverter* cnv, bool to_utf8)
+	    : cnv(cnv), to_utf8(to_utf8)
+	{
+		auto uerr = U_ZERO_ERROR;
+		utf8_cnv.adoptInstead(ucnv_open("UTF-8", &uerr));
+		assert(U_SUCCESS(uerr));
 	}
-}
+	Block_Converter(const Block_Converter&) = delete;
+	auto operator=(const Block_Converter&) -> Block_Converter& = delete;
 
-auto to_unicode_string(string_view source, icu::UnicodeString& dest,
-                       UConverter* ucnv, UErrorCode& uerr)
-{
-	auto buf = dest.getBuffer(-1);
-	auto len = ucnv_toUChars(ucnv, buf, dest.getCapacity(), source.data(),
-	                         source.size(), &uerr);
-	if (uerr == U_BUFFER_OVERFLOW_ERROR) {
-		uerr = U_ZERO_ERROR;
-		dest.releaseBuffer(0);
-		buf = dest.getBuffer(len);
-		if (!buf)
-			throw bad_alloc();
-		len = ucnv_toUChars(ucnv, buf, dest.getCapacity(),
-		                    source.data(), source.size(), &uerr);
-	}
-	dest.releaseBuffer(len);
-}
+	/**
+	 * @brief Appends the converted text to out.
+	 *
+	 * With @p flush the input is complete and an incomplete character at
+	 * its end is converted too.
+	 */
+	auto convert(string_view in, string& out, bool flush = false) -> void
+	{
+		auto source_cnv = to_utf8 ? cnv : utf8_cnv.getAlias();
+		auto target_cnv = to_utf8 ? utf8_cnv.getAlias() : cnv;
+		auto src = in.empty() ? "" : in.data(); // ICU rejects null
+		auto src_end = src + in.size();
+		auto len = out.size();
+		out.resize(len + in.size() + in.size() / 2 + 16);
+		for (;;) {
+			auto uerr = U_ZERO_ERROR;
+			auto dest = out.data() + len;
+			ucnv_convertEx(target_cnv, source_cnv, &dest,
+			               out.data() + out.size(), &src, src_end,
+			               pivot, &pivot_source, &pivot_target,
+			               pivot + size(pivot), false, flush,
+			               &uerr);
+			len = dest - out.data();
+			if (uerr != U_BUFFER_OVERFLOW_ERROR) {
+				assert(U_SUCCESS(uerr));
+				break;
+			}
+			out.resize(out.size() * 2);
+		}
+		out.resize(len);
+	}
+};
 
-auto process_word_utf8_output_enc(const Dictionary& dic, string_view word,
-                                  vector<string>& suggestions, ostream& out)
-{
-	auto correct = dic.spell(word);
-	if (correct) {
-		out << "* OK\n";
-		return;
+/**
+ * @brief Converts input text to UTF-8, UTF-8 input is used as it is.
+ */
+class Text_Decoder {
+	optional<Block_Converter> decoder;
+
+      public:
+	explicit Text_Decoder(UConverter* in_cnv)
+	{
+		if (ucnv_getType(in_cnv) != UCNV_UTF8)
+			decoder.emplace(in_cnv, true);
 	}
-	dic.suggest(word, suggestions);
-	if (suggestions.empty()) {
-		out << "# Wrong: " << word << ". No suggestions.\n";
-		return;
+
+	/**
+	 * @brief Returns text in UTF-8, converted into buf if needed.
+	 */
+	auto decode(string_view text, string& buf, bool flush = false)
+	    -> string_view
+	{
+		if (!decoder)
+			return text;
+		buf.clear();
+		decoder->convert(text, buf, flush);
+		return buf;
 	}
-	out << "& Wrong: " << word << ". How about: ";
-	out << suggestions[0];
-	for_each(begin(suggestions) + 1, end(suggestions),
-	         [&](auto& sug) { out << ", " << sug; });
-	out << '\n';
-}
+};
+
+/**
+ * @brief Writes UTF-8 text to a stream, converted to the output encoding.
+ *
+ * The output is built in UTF-8 and converted in bulk here, not word by word.
+ */
+class Text_Writer {
+	ostream& out;
+	optional<Block_Converter> encoder; // empty if the output is UTF-8
+	string encoded;
+
+      public:
+	/**
+	 * @brief Constructs a writer, with null @p out_cnv text is written as
+	 * it is.
+	 */
+	Text_Writer(ostream& out, UConverter* out_cnv) : out(out)
+	{
+		if (out_cnv && ucnv_getType(out_cnv) != UCNV_UTF8)
+			encoder.emplace(out_cnv, false);
+	}
+	~Text_Writer()
+	{
+		if (!encoder)
+			return;
+		encoded.clear();
+		encoder->convert({}, encoded, true);
+		out << encoded;
+	}
+	Text_Writer(const Text_Writer&) = delete;
+	auto operator=(const Text_Writer&) -> Text_Writer& = delete;
+	auto write(string_view u8text) -> void
+	{
+		if (!encoder) {
+			out << u8text;
+			return;
+		}
+		encoded.clear();
+		encoder->convert(u8text, encoded);
+		out << encoded;
+	}
+	auto flush() -> void { out.flush(); }
+};
 
-auto process_word_any_output_enc(const Dictionary& dic, string_view u8word,
-                                 vector<string>& suggestions, ostream& out,
-                                 UConverter* out_cnv, UErrorCode& uerr)
+/**
+ * @brief Appends the result of checking a word, for the mode NORMAL.
+ */
+auto append_word_result(string_view word, bool correct,
+                        const vector<string>& suggestions, string& out)
 {
-	auto correct = dic.spell(u8word);
 	if (correct) {
-		out << "* OK\n";
+		out += "* OK\n";
 		return;
 	}
-	dic.suggest(u8word, suggestions);
-	auto encoded_out = string();
-	from_utf8(u8word, encoded_out, out_cnv, uerr);
 	if (suggestions.empty()) {
-		out << "# Wrong: " << encoded_out << ". No suggestions.\n";
+		out += "# Wrong: ";
+		out += word;
+		out += ". No suggestions.\n";
 		return;
 	}
-	out << "& Wrong:  " << encoded_out << ". How about: ";
-	from_utf8(suggestions[0], encoded_out, out_cnv, uerr);
-	out << encoded_out;
-	for_each(begin(suggestions) + 1, end(suggestions),
-	         [&](const string& u8sug) {
-		         out << ", ";
-		         from_utf8(u8sug, encoded_out, out_cnv, uerr);
-		         out << encoded_out;
-	         });
-	out << '\n';
+	out += "& Wrong: ";
+	out += word;
+	out += ". How about: ";
+	out += suggestions[0];
+	for_each(begin(suggestions) + 1, end(suggestions), [&](auto& sug) {
+		out += ", ";
+		out += sug;
+	});
+	out += '\n';
 }
 
 auto is_word_break(int32_t typ)
@@ -228,109 +420,1146 @@ auto is_word_break(int32_t typ)
 	       (UBRK_WORD_IDEO <= typ && typ < UBRK_WORD_IDEO_LIMIT);
 }
 
-auto process_line_utf8_input_enc(const Dictionary& dic, const string& line,
-                                 UText* utext, icu::BreakIterator* ubrkiter,
-                                 vector<string>& suggestions, ostream& out,
-                                 UConverter* out_cnv, UErrorCode& uerr)
+template <class Func>
+auto for_each_word_utf8_input_enc(string_view line, UText* utext,
+                                  icu::BreakIterator* ubrkiter,
+                                  UErrorCode& uerr, Func word_func)
 {
 	utext_openUTF8(utext, line.data(), line.size(), &uerr);
 	ubrkiter->setText(utext, uerr);
-	auto is_utf8_out = ucnv_getType(out_cnv) == UCNV_UTF8;
 	for (auto i = ubrkiter->first(), prev = 0; i != ubrkiter->DONE;
 	     prev = i, i = ubrkiter->next()) {
 		auto typ = ubrkiter->getRuleStatus();
-		if (is_word_break(typ)) {
-			auto word = string_view(line).substr(prev, i - prev);
-			if (is_utf8_out)
-				process_word_utf8_output_enc(dic, word,
-				                             suggestions, out);
-			else
-				process_word_any_output_enc(
-				    dic, word, suggestions, out, out_cnv, uerr);
-		}
+		if (is_word_break(typ))
+			word_func(line.substr(prev, i - prev));
 	}
 	assert(U_SUCCESS(uerr));
 }
 
-auto process_line_any_input_enc(const Dictionary& dic, const string& line,
-                                icu::UnicodeString& uline, UConverter* in_cnv,
-                                icu::BreakIterator* ubrkiter, UErrorCode& uerr,
-                                string& u8word, vector<string>& suggestions,
-                                ostream& out, UConverter* out_cnv)
-{
-	to_unicode_string(line, uline, in_cnv, uerr);
-	ubrkiter->setText(uline);
-	/* size_t orig_prev = 0, orig_i = 0;
-	auto src = line.c_str();
-	auto src_end = src + line.size(); */
-	auto is_utf8_out = ucnv_getType(out_cnv) == UCNV_UTF8;
-	ucnv_resetToUnicode(in_cnv);
-	for (auto i = ubrkiter->first(), prev = 0; i != ubrkiter->DONE;
-	     prev = i, i = ubrkiter->next() /*, orig_prev = orig_i*/) {
+/**
+ * @brief Counts distinct words, keeping the order of first appearance.
+ */
+class Word_Counts {
+	unordered_map<string, size_t> counts;
+	vector<const pair<const string, size_t>*> order;
+	string key;
+
+      public:
+	auto add(string_view word, size_t n = 1) -> void
+	{
+		key = word;
+		auto it = counts.find(key);
+		if (it == end(counts)) {
+			it = counts.emplace(key, 0).first;
+			order.push_back(&*it);
+		}
+		it->second += n;
+	}
+	auto merge(const Word_Counts& other) -> void
+	{
+		for (auto w : other.order)
+			add(w->first, w->second);
+	}
+	template <class Func>
+	auto for_each(Func func) const
+	{
+		for (auto w : order)
+			func(string_view(w->first), w->second);
+	}
+	auto size() const { return order.size(); }
+};
+
+/**
+ * @brief Counts the latencies of an operation in buckets of powers of two.
+ *
+ * The bucket i counts the latencies from 2^i to 2^(i+1) nanoseconds, the
+ * first bucket also counts those below 1 ns.
+ */
+class Latency_Histogram {
+	array<size_t, 48> buckets = {};
+	size_t num = 0;
+	chrono::nanoseconds sum = {};
+	chrono::nanoseconds longest = {};
 
-		/* for (auto j = prev; j != i; ++j) {
-		        auto cp =
-		            ucnv_getNextUChar(in_cnv, &src, src_end, &uerr);
+      public:
+	auto add(chrono::nanoseconds t) -> void
+	{
+		auto ns = t.count();
+		auto i = size_t(0);
+		while (i + 1 != size(buckets) && ns >> (i + 1))
+			++i;
+		++buckets[i];
+		++num;
+		sum += t;
+		longest = max(longest, t);
+	}
+	auto merge(const Latency_Histogram& other) -> void
+	{
+		for (size_t i = 0; i != size(buckets); ++i)
+			buckets[i] += other.buckets[i];
+		num += other.num;
+		sum += other.sum;
+		longest = max(longest, other.longest);
+	}
+	auto count() const { return num; }
+	auto total() const { return sum; }
+	auto max_latency() const { return longest; }
+	auto mean() const -> chrono::nanoseconds
+	{
+		return num ? sum / chrono::nanoseconds::rep(num) : sum;
+	}
 
-		        // U_IS_SURROGATE(uline[j]) or
-		        // U_IS_LEAD(uline[j]) can work too
-		        j += !U_IS_BMP(cp);
+	/**
+	 * @brief Returns the upper bound of the bucket with the percentile p.
+	 *
+	 * @param p in the range (0, 1], for example 0.99.
+	 */
+	auto percentile(double p) const -> chrono::nanoseconds
+	{
+		auto rank = size_t(ceil(p * num));
+		auto seen = size_t(0);
+		for (size_t i = 0; i != size(buckets); ++i) {
+			seen += buckets[i];
+			if (seen >= rank && seen != 0)
+				return chrono::nanoseconds(2ll << i);
 		}
-		orig_i = distance(line.c_str(), src); */
+		return {};
+	}
 
-		auto typ = ubrkiter->getRuleStatus();
-		if (is_word_break(typ)) {
-			auto uword = uline.tempSubStringBetween(prev, i);
-			u8word.clear();
-			uword.toUTF8String(u8word);
-			/* auto enc_word = string_view(line).substr(
-			    orig_prev, orig_i - orig_prev); */
-
-			if (is_utf8_out)
-				process_word_utf8_output_enc(dic, u8word,
-				                             suggestions, out);
-			else
-				process_word_any_output_enc(dic, u8word,
-				                            suggestions, out,
-				                            out_cnv, uerr);
+	/**
+	 * @brief Calls func(upper_bound, count) for each non-empty bucket.
+	 */
+	template <class Func>
+	auto for_each_bucket(Func func) const
+	{
+		for (size_t i = 0; i != size(buckets); ++i)
+			if (buckets[i])
+				func(chrono::nanoseconds(2ll << i), buckets[i]);
+	}
+};
+
+/**
+ * @brief The output and the counts of checked text.
+ */
+struct Check_Result {
+	string out;         ///< output in UTF-8
+	Word_Counts counts; ///< words counted in the mode UNIQUE_MISSPELLED
+	size_t bytes = 0;
+	size_t words = 0;
+	size_t misspelled = 0;
+	Latency_Histogram spell_latency;   ///< only with Check_Options::stats
+	Latency_Histogram suggest_latency; ///< only with Check_Options::stats
+
+	auto merge(const Check_Result& other) -> void
+	{
+		counts.merge(other.counts);
+		bytes += other.bytes;
+		words += other.words;
+		misspelled += other.misspelled;
+		spell_latency.merge(other.spell_latency);
+		suggest_latency.merge(other.suggest_latency);
+	}
+};
+
+/**
+ * @brief How the text is checked and what is written for it.
+ */
+struct Check_Options {
+	Mode mode = Mode::NORMAL;
+	bool fast_tokenizer = false;
+	bool raw_lines = false; ///< write lines as they were read, for -L
+	bool stats = false;     ///< measure the latency of each spell/suggest
+};
+
+/**
+ * @brief Segments lines into words and checks them.
+ *
+ * It holds the state that can not be shared between threads, so each thread
+ * that checks text needs its own. The input and the output are in UTF-8. What
+ * is written for each line depends on the mode.
+ */
+class Line_Checker {
+	const Dictionary& dic;
+	Check_Options opt;
+	UErrorCode uerr = U_ZERO_ERROR;
+	string empty_line;
+	unique_ptr<icu::BreakIterator> ubrkiter;
+	icu::LocalUTextPointer utext;
+	vector<string> suggestions;
+
+	template <class Func>
+	auto for_each_word(string_view line, Func word_func)
+	{
+		if (opt.fast_tokenizer)
+			dic.tokenize(line, word_func);
+		else
+			for_each_word_utf8_input_enc(line, utext.getAlias(),
+			                             ubrkiter.get(), uerr,
+			                             word_func);
+	}
+
+	auto suggest(string_view word, Check_Result& r) -> void
+	{
+		if (!opt.stats)
+			return dic.suggest(word, suggestions);
+		auto start = chrono::steady_clock::now();
+		dic.suggest(word, suggestions);
+		r.suggest_latency.add(chrono::steady_clock::now() - start);
+	}
+
+      public:
+	Line_Checker(const Dictionary& dic, const Check_Options& opt)
+	    : dic(dic), opt(opt)
+	{
+		// TODO: try to use Locale constructed from dictionary name.
+		ubrkiter.reset(icu::BreakIterator::createWordInstance(
+		    icu::Locale(), uerr));
+		utext.adoptInstead(utext_openUTF8(nullptr, empty_line.data(),
+		                                  empty_line.size(), &uerr));
+	}
+
+	/**
+	 * @brief Checks a word, with latency measured if the options say so.
+	 */
+	auto spell(string_view word, Check_Result& r) -> bool
+	{
+		if (!opt.stats)
+			return dic.spell(word);
+		auto start = chrono::steady_clock::now();
+		auto correct = dic.spell(word);
+		r.spell_latency.add(chrono::steady_clock::now() - start);
+		return correct;
+	}
+
+	/**
+	 * @brief Checks one line of input and appends the output to r.out.
+	 *
+	 * The line is in UTF-8, @p raw_line is the same line as it was read.
+	 * In the mode UNIQUE_MISSPELLED nothing is written, the words are
+	 * only counted into r.counts and checked later.
+	 */
+	auto process_line(string_view line, string_view raw_line,
+	                  Check_Result& r) -> void
+	{
+		auto& out = r.out;
+		switch (opt.mode) {
+		case Mode::MISSPELLED_WORDS:
+			for_each_word(line, [&](string_view word) {
+				++r.words;
+				if (spell(word, r))
+					return;
+				++r.misspelled;
+				out += word;
+				out += '\n';
+			});
+			break;
+		case Mode::MISSPELLED_LINES: {
+			auto misspelled = r.misspelled;
+			for_each_word(line, [&](string_view word) {
+				++r.words;
+				r.misspelled += !spell(word, r);
+			});
+			if (misspelled != r.misspelled) {
+				out += opt.raw_lines ? raw_line : line;
+				out += '\n';
+			}
+			break;
+		}
+		case Mode::UNIQUE_MISSPELLED:
+			for_each_word(line, [&](string_view word) {
+				++r.words;
+				r.counts.add(word);
+			});
+			break;
+		default:
+			for_each_word(line, [&](string_view word) {
+				++r.words;
+				auto correct = spell(word, r);
+				if (!correct) {
+					++r.misspelled;
+					suggest(word, r);
+				}
+				append_word_result(word, correct, suggestions,
+				                   out);
+			});
+			out += '\n'; // In NORMAL mode put empty line for each
+			              // input line.
 		}
 	}
-	assert(U_SUCCESS(uerr));
+};
+
+/**
+ * @brief Prints the misspelled words among the counted ones.
+ *
+ * Each distinct word is checked only once. The words are printed in the
+ * order of their first appearance, each followed by a tab and its count.
+ *
+ * The number of occurrences of the misspelled words is added to r.misspelled.
+ */
+auto print_unique_misspelled(Line_Checker& checker, Check_Result& r,
+                             Text_Writer& out)
+{
+	auto buf = string();
+	r.counts.for_each([&](string_view word, size_t count) {
+		if (checker.spell(word, r))
+			return;
+		r.misspelled += count;
+		buf += word;
+		buf += '\t';
+		buf += to_string(count);
+		buf += '\n';
+	});
+	out.write(buf);
 }
 
-auto process_text(const Dictionary& dic, istream& in, UConverter* in_cnv,
-                  ostream& out, UConverter* out_cnv, UErrorCode& uerr)
+/**
+ * @brief Checks text with the pipe protocol of ispell, option -a.
+ *
+ * Each line of input is either a command or text to check. For each word of
+ * the text one response line is written, and the responses for the whole line
+ * end with an empty line. The output is flushed after each response to a text
+ * line, so clients can wait for it. Offsets are in code points, counted from
+ * the start of the input line.
+ */
+class Pipe_Checker {
+	const Dictionary& dic;
+	Text_Decoder decoder;
+	UErrorCode uerr = U_ZERO_ERROR;
+	unique_ptr<icu::BreakIterator> ubrkiter;
+	icu::LocalUTextPointer utext;
+	string u8line;
+	string response;
+	string key;
+	vector<string> suggestions;
+	unordered_set<string> session_words;
+	icu::Locale locale;
+	bool fast_tokenizer;
+	bool terse = false;
+
+	/**
+	 * @brief Accepts a word for the rest of the session.
+	 *
+	 * Like a word in the dictionary, a word in lowercase is accepted in
+	 * title case and upper case too, and other words in upper case.
+	 */
+	auto add_session_word(string_view word, bool lowercase)
+	{
+		using nuspell::Casing, nuspell::to_upper, nuspell::to_title;
+		auto w = lowercase ? nuspell::to_lower(word, locale)
+		                   : string(word);
+		auto casing = nuspell::classify_casing(w);
+		if (casing == Casing::SMALL)
+			session_words.insert(to_title(w, locale));
+		if (casing != Casing::ALL_CAPITAL)
+			session_words.insert(to_upper(w, locale));
+		session_words.insert(std::move(w));
+	}
+	auto is_correct(string_view word)
+	{
+		if (dic.spell(word))
+			return true;
+		if (session_words.empty())
+			return false;
+		key = word;
+		return session_words.count(key) != 0;
+	}
+	auto check_text(string_view text, size_t offset, Text_Writer& out)
+	{
+		auto cp_offset = offset;
+		auto counted = text.data();
+		auto& r = response;
+		r.clear();
+		auto check_word = [&](string_view word) {
+			for (; counted != word.data(); ++counted)
+				cp_offset += (*counted & 0xC0) != 0x80;
+			if (is_correct(word)) {
+				if (!terse)
+					r += "*\n";
+				return;
+			}
+			dic.suggest(word, suggestions);
+			r += suggestions.empty() ? "# " : "& ";
+			r += word;
+			if (!suggestions.empty()) {
+				r += ' ';
+				r += to_string(suggestions.size());
+			}
+			r += ' ';
+			r += to_string(cp_offset);
+			if (!suggestions.empty()) {
+				r += ": ";
+				r += suggestions[0];
+			}
+			for_each(begin(suggestions) + !suggestions.empty(),
+			         end(suggestions), [&](auto& sug) {
+				         r += ", ";
+				         r += sug;
+			         });
+			r += '\n';
+		};
+		if (fast_tokenizer)
+			dic.tokenize(text, check_word);
+		else
+			for_each_word_utf8_input_enc(text, utext.getAlias(),
+			                             ubrkiter.get(), uerr,
+			                             check_word);
+		r += '\n';
+		out.write(r);
+		out.flush();
+	}
+
+      public:
+	Pipe_Checker(const Dictionary& dic, UConverter* in_cnv,
+	             const icu::Locale& locale, bool fast_tokenizer)
+	    : dic(dic), decoder(in_cnv), locale(locale),
+	      fast_tokenizer(fast_tokenizer)
+	{
+		ubrkiter.reset(icu::BreakIterator::createWordInstance(
+		    icu::Locale(), uerr));
+		utext.adoptInstead(utext_openUTF8(nullptr, key.data(),
+		                                  key.size(), &uerr));
+	}
+
+	auto print_banner(Text_Writer& out) -> void
+	{
+		out.write("@(#) International Ispell Version 3.2.06 (but "
+		          "really Nuspell " PROJECT_VERSION ")\n");
+		out.flush();
+	}
+
+	/**
+	 * @brief Executes one line of the protocol.
+	 *
+	 * Supported commands are: ! and % to turn terse mode on and off, * &
+	 * and @ to accept a word for the rest of the session (& in lowercase),
+	 * # to save the personal dictionary (does nothing) and ^ to check the
+	 * rest of the line as text. The TeX/nroff mode commands + - ~ and $$
+	 * are accepted and ignored. Other lines are checked as text.
+	 */
+	auto process_line(string_view line, Text_Writer& out) -> void
+	{
+		line = decoder.decode(line, u8line);
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
+		auto command = line.empty() ? '\0' : line[0];
+		switch (command) {
+		case '!':
+			terse = true;
+			break;
+		case '%':
+			terse = false;
+			break;
+		case '*':
+		case '&':
+		case '@':
+			if (line.size() > 1)
+				add_session_word(line.substr(1), command == '&');
+			break;
+		case '#':
+		case '+':
+		case '-':
+		case '~':
+			break;
+		case '$':
+			if (line.substr(0, 2) != "$$")
+				check_text(line, 0, out);
+			break;
+		case '^':
+			check_text(line.substr(1), 1, out);
+			break;
+		default:
+			check_text(line, 0, out);
+		}
+	}
+};
+
+/**
+ * @brief Runs the ispell pipe protocol on in, timing each request.
+ *
+ * With @p print_stats, the number of requests and their latency in
+ * microseconds are printed to clog at the end.
+ */
+auto run_pipe(const Dictionary& dic, istream& in, UConverter* in_cnv,
+              const icu::Locale& locale, Text_Writer& out,
+              bool fast_tokenizer, bool print_stats)
 {
+	auto checker = Pipe_Checker(dic, in_cnv, locale, fast_tokenizer);
 	auto line = string();
-	auto suggestions = vector<string>();
-	auto wrong_words = vector<string_view>();
-
-	// TODO: try to use Locale constructed from dictionary name.
-	auto ubrkiter = unique_ptr<icu::BreakIterator>(
-	    icu::BreakIterator::createWordInstance(icu::Locale(), uerr));
-	auto utext = icu::LocalUTextPointer(
-	    utext_openUTF8(nullptr, line.data(), line.size(), &uerr));
-	auto uline = icu::UnicodeString();
-	auto u8word = string();
-	auto is_utf8 = ucnv_getType(in_cnv) == UCNV_UTF8;
-
-	if (&in == &cin)
-		out << "Enter some text: ";
+	auto num_requests = size_t(0);
+	auto total = chrono::microseconds();
+	auto max_latency = chrono::microseconds();
+	checker.print_banner(out);
 	while (getline(in, line)) {
-		wrong_words.clear();
-		if (is_utf8)
-			process_line_utf8_input_enc(dic, line, utext.getAlias(),
-			                            ubrkiter.get(), suggestions,
-			                            out, out_cnv, uerr);
-		else
-			process_line_any_input_enc(dic, line, uline, in_cnv,
-			                           ubrkiter.get(), uerr, u8word,
-			                           suggestions, out, out_cnv);
+		auto start = chrono::steady_clock::now();
+		checker.process_line(line, out);
+		auto latency = chrono::duration_cast<chrono::microseconds>(
+		    chrono::steady_clock::now() - start);
+		++num_requests;
+		total += latency;
+		max_latency = max(max_latency, latency);
+	}
+	if (!print_stats)
+		return;
+	clog << "INFO: Pipe requests " << num_requests << ", total "
+	     << total.count() << " us, mean "
+	     << (num_requests ? total.count() / num_requests : 0)
+	     << " us, max " << max_latency.count() << " us" << endl;
+}
 
-		out << '\n'; // In NORMAL mode put empty line for each input
-		             // line.
+/**
+ * @brief Calls func for each line of text, split the same way as getline().
+ */
+template <class Func>
+auto for_each_line(string_view text, Func func)
+{
+	while (!text.empty()) {
+		auto i = text.find('\n');
+		func(text.substr(0, i));
+		text.remove_prefix(i == text.npos ? text.size() : i + 1);
 	}
 }
+
+auto is_terminal_input() -> bool
+{
+#ifdef _POSIX_VERSION
+	return isatty(STDIN_FILENO);
+#elif _WIN32
+	return _isatty(_fileno(stdin));
+#else
+	return true;
+#endif
+}
+
+/**
+ * @brief Checks the input line by line, writing the output of each line.
+ *
+ * This is for interactive input. Other input is read in blocks.
+ */
+auto process_lines(Line_Checker& checker, istream& in, UConverter* in_cnv,
+                   Text_Writer& out, Check_Result& r)
+{
+	auto decoder = Text_Decoder(in_cnv);
+	auto line = string();
+	auto u8line = string();
+	while (getline(in, line)) {
+		r.bytes += line.size() + 1;
+		checker.process_line(decoder.decode(line, u8line), line, r);
+		out.write(r.out);
+		r.out.clear();
+	}
+}
+
+/**
+ * @brief Read-only memory map of a whole regular file.
+ *
+ * Mapping fails for anything that is not a regular file, like pipes and
+ * terminals, and on systems without mmap(). Such files are read as streams.
+ */
+class Mapped_File {
+	const char* data = nullptr;
+	size_t size = 0;
+	bool mapped = false;
+
+      public:
+	explicit Mapped_File(const char* file_name)
+	{
+#ifdef _POSIX_VERSION
+		auto fd = open(file_name, O_RDONLY);
+		if (fd == -1)
+			return;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+			size = st.st_size;
+			auto p = size == 0 ? nullptr
+			                   : mmap(nullptr, size, PROT_READ,
+			                          MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) {
+				data = static_cast<const char*>(p);
+				mapped = true;
+				if (p)
+					posix_madvise(p, size,
+					              POSIX_MADV_SEQUENTIAL);
+			}
+		}
+		close(fd);
+#endif
+	}
+	~Mapped_File()
+	{
+#ifdef _POSIX_VERSION
+		if (data)
+			munmap(const_cast<char*>(data), size);
+#endif
+	}
+	Mapped_File(const Mapped_File&) = delete;
+	auto operator=(const Mapped_File&) -> Mapped_File& = delete;
+	auto is_mapped() const { return mapped; }
+	auto text() const { return string_view(data, size); }
+};
+
+/**
+ * @brief Opens a file and calls func with the source of its text.
+ *
+ * The source is the mapped text of the file or, if it can not be mapped, an
+ * input stream.
+ *
+ * @return false if the file can not be opened.
+ */
+template <class Func>
+auto with_file_source(const string& file_name, Func func) -> bool
+{
+	auto mapped = Mapped_File(file_name.c_str());
+	if (mapped.is_mapped()) {
+		auto text = mapped.text();
+		func(text);
+		return true;
+	}
+	ifstream in(file_name);
+	if (!in.is_open())
+		return false;
+	func(in);
+	return true;
+}
+
+/**
+ * @internal
+ * @brief Whole lines of input, checked by one worker thread.
+ */
+struct Text_Block {
+	string buffer;    // owns the text if it was read from a stream
+	string converted; // owns the text if it was converted to UTF-8
+	string_view raw;  // the text as it was read
+	string_view text; // the text in UTF-8
+	Check_Result result;
+	bool done = false;
+};
+constexpr size_t text_block_bytes = 64 * 1024;
+
+auto read_block(istream& in, Text_Block& b) -> bool
+{
+	b.buffer.resize(text_block_bytes);
+	in.read(b.buffer.data(), b.buffer.size());
+	b.buffer.resize(in.gcount());
+	if (!b.buffer.empty() && b.buffer.back() != '\n') {
+		// complete the last line
+		auto rest = string();
+		getline(in, rest);
+		b.buffer += rest;
+	}
+	b.text = b.buffer;
+	return !b.text.empty();
+}
+
+auto read_block(string_view& mapped, Text_Block& b) -> bool
+{
+	auto len = mapped.find('\n', min(text_block_bytes, mapped.size()));
+	len = len == mapped.npos ? mapped.size() : len + 1;
+	b.text = mapped.substr(0, len);
+	mapped.remove_prefix(len);
+	return !b.text.empty();
+}
+
+/**
+ * @brief Reads the next block of lines and converts it to UTF-8.
+ */
+template <class Source>
+auto read_utf8_block(Source& source, Text_Decoder& decoder, Text_Block& b)
+    -> bool
+{
+	auto has_text = read_block(source, b);
+	b.raw = b.text;
+	b.text = decoder.decode(b.raw, b.converted, !has_text);
+	return !b.text.empty();
+}
+
+/**
+ * @brief Calls func for each line of a block, in UTF-8 and as it was read.
+ */
+template <class Func>
+auto for_each_line(const Text_Block& b, Func func)
+{
+	auto raw = b.raw;
+	for_each_line(b.text, [&](string_view line) {
+		auto i = raw.find('\n');
+		func(line, raw.substr(0, i));
+		raw.remove_prefix(i == raw.npos ? raw.size() : i + 1);
+	});
+}
+
+/**
+ * @brief Checks the input in blocks of lines.
+ *
+ * The input of each block is converted to UTF-8 at once, and the output of
+ * each block is converted to the output encoding at once. If @p out is null,
+ * the output of the whole input is left in r.out. Otherwise, @p header is
+ * written before the first output, if there is any.
+ */
+template <class Source>
+auto process_text(Line_Checker& checker, Source& source, UConverter* in_cnv,
+                  Text_Writer* out, string_view header, Check_Result& r)
+{
+	auto decoder = Text_Decoder(in_cnv);
+	auto b = Text_Block();
+	while (read_utf8_block(source, decoder, b)) {
+		r.bytes += b.raw.size();
+		for_each_line(b, [&](string_view line, string_view raw) {
+			checker.process_line(line, raw, r);
+		});
+		if (!out || r.out.empty())
+			continue;
+		out->write(header);
+		header = {};
+		out->write(r.out);
+		r.out.clear();
+	}
+}
+
+/**
+ * @brief Same as process_text(), but checks with multiple threads.
+ *
+ * The calling thread reads the input in blocks of lines, converts them to
+ * UTF-8 and writes the output of the blocks in input order. The worker threads
+ * take the blocks in order and check them, each with its own break iterator.
+ * The number of blocks in flight is bounded, so the memory use does not
+ * depend on the size of the input. Blocks of mapped UTF-8 text are not copied.
+ */
+template <class Source>
+auto process_text_parallel(const Dictionary& dic, Source& source,
+                           UConverter* in_cnv, Text_Writer& out,
+                           string_view header, const Check_Options& opt,
+                           Check_Result& r, size_t jobs)
+{
+	auto decoder = Text_Decoder(in_cnv);
+	auto max_blocks = jobs * 4;
+	auto blocks = deque<unique_ptr<Text_Block>>();
+	auto first_block = size_t(0); // index of blocks.front() in input
+	auto next_block = size_t(0);  // index of the next block to check
+	auto eof = false;
+	auto mtx = mutex();
+	auto block_ready = condition_variable();
+	auto block_done = condition_variable();
+
+	auto worker = [&]() {
+		auto checker = Line_Checker(dic, opt);
+		auto has_unchecked = [&] {
+			return next_block != first_block + blocks.size();
+		};
+		for (;;) {
+			auto lock = unique_lock(mtx);
+			block_ready.wait(
+			    lock, [&] { return eof || has_unchecked(); });
+			if (!has_unchecked())
+				return;
+			auto& b = *blocks[next_block++ - first_block];
+			lock.unlock();
+			for_each_line(b, [&](string_view line, string_view r) {
+				checker.process_line(line, r, b.result);
+			});
+			lock.lock();
+			b.done = true;
+			block_done.notify_one();
+		}
+	};
+	auto threads = vector<thread>();
+	for (size_t i = 0; i != jobs; ++i)
+		threads.emplace_back(worker);
+
+	auto write_front = [&](unique_lock<mutex>& lock) {
+		block_done.wait(lock, [&] { return blocks.front()->done; });
+		auto b = std::move(blocks.front());
+		blocks.pop_front();
+		++first_block;
+		lock.unlock();
+		if (!b->result.out.empty()) {
+			out.write(header);
+			header = {};
+			out.write(b->result.out);
+		}
+		r.merge(b->result);
+		lock.lock();
+	};
+	for (;;) {
+		auto b = make_unique<Text_Block>();
+		auto has_text = read_utf8_block(source, decoder, *b);
+		b->result.bytes = b->raw.size();
+		auto lock = unique_lock(mtx);
+		if (!has_text)
+			break;
+		while (blocks.size() == max_blocks)
+			write_front(lock);
+		blocks.push_back(std::move(b));
+		block_ready.notify_one();
+	}
+	auto lock = unique_lock(mtx);
+	eof = true;
+	block_ready.notify_all();
+	while (!blocks.empty())
+		write_front(lock);
+	lock.unlock();
+	for (auto& t : threads)
+		t.join();
+}
+
+/**
+ * @brief Matches one character of a shell pattern, ? or [...] or a literal.
+ *
+ * @return the length of the matched pattern element, 0 if not matched.
+ */
+auto match_glob_char(string_view pattern, char c) -> size_t
+{
+	if (pattern[0] == '?')
+		return 1;
+	if (pattern[0] != '[')
+		return pattern[0] == c;
+	auto uc = static_cast<unsigned char>(c);
+	auto i = size_t(1);
+	auto negate = i != pattern.size() &&
+	              (pattern[i] == '!' || pattern[i] == '^');
+	i += negate;
+	auto found = false;
+	for (auto first = i; i != pattern.size(); ++i) {
+		if (pattern[i] == ']' && i != first)
+			break;
+		auto lo = static_cast<unsigned char>(pattern[i]);
+		auto hi = lo;
+		if (i + 2 < pattern.size() && pattern[i + 1] == '-' &&
+		    pattern[i + 2] != ']') {
+			hi = static_cast<unsigned char>(pattern[i + 2]);
+			i += 2;
+		}
+		found = found || (lo <= uc && uc <= hi);
+	}
+	if (i == pattern.size())
+		return c == '['; // no closing bracket, [ is literal
+	return found != negate ? i + 1 : 0;
+}
+
+/**
+ * @brief Matches a file name against a shell pattern with *, ? and [...].
+ *
+ * The name is matched byte by byte, ? matches one byte.
+ */
+auto match_glob(string_view pattern, string_view name) -> bool
+{
+	auto p = size_t(0);
+	auto n = size_t(0);
+	auto star_p = pattern.npos; // position after the last *
+	auto star_n = size_t(0);    // position in name where the last * ends
+	while (n != name.size()) {
+		if (p != pattern.size() && pattern[p] == '*') {
+			star_p = ++p;
+			star_n = n;
+			continue;
+		}
+		if (p != pattern.size()) {
+			auto len = match_glob_char(pattern.substr(p), name[n]);
+			if (len) {
+				p += len;
+				++n;
+				continue;
+			}
+		}
+		if (star_p == pattern.npos)
+			return false;
+		// let the last * match one more byte
+		p = star_p;
+		n = ++star_n;
+	}
+	while (p != pattern.size() && pattern[p] == '*')
+		++p;
+	return p == pattern.size();
+}
+
+/**
+ * @brief Selects the files found in directories, options --include and
+ * --exclude.
+ */
+struct File_Filter {
+	vector<string> include; ///< patterns of file names to check
+	vector<string> exclude; ///< patterns of names to skip, also directories
+
+	auto is_excluded(string_view name) const -> bool
+	{
+		return any_of(begin(exclude), end(exclude),
+		              [&](auto& p) { return match_glob(p, name); });
+	}
+	auto is_included(string_view name) const -> bool
+	{
+		return include.empty() ||
+		       any_of(begin(include), end(include),
+		              [&](auto& p) { return match_glob(p, name); });
+	}
+};
+
+/**
+ * @brief Appends the paths of the files in a directory tree to the list.
+ *
+ * The entries of each directory are visited sorted by name, so the list is
+ * the same on each run. Symbolic links to directories are not followed.
+ *
+ * @return false if some directory can not be read.
+ */
+auto append_dir_files(const filesystem::path& dir, const File_Filter& filter,
+                      vector<string>& files) -> bool
+{
+	auto entries = vector<filesystem::directory_entry>();
+	try {
+		for (auto& e : filesystem::directory_iterator(dir))
+			entries.push_back(e);
+	}
+	catch (const filesystem::filesystem_error& e) {
+		clog << "ERROR: " << e.what() << '\n';
+		return false;
+	}
+	sort(begin(entries), end(entries));
+	auto ok = true;
+	for (auto& e : entries) {
+		auto name = e.path().filename().string();
+		if (filter.is_excluded(name))
+			continue;
+		auto ec = error_code();
+		if (e.is_directory(ec) && !e.is_symlink(ec))
+			ok = append_dir_files(e.path(), filter, files) && ok;
+		else if (e.is_regular_file(ec) && filter.is_included(name))
+			files.push_back(e.path().string());
+	}
+	return ok;
+}
+
+auto clone_converter(const UConverter* cnv)
+{
+	auto uerr = U_ZERO_ERROR;
+#if U_ICU_VERSION_MAJOR_NUM >= 71
+	auto clone = ucnv_clone(cnv, &uerr);
+#else
+	auto clone = ucnv_safeClone(cnv, nullptr, nullptr, &uerr);
+#endif
+	assert(U_SUCCESS(uerr));
+	return icu::LocalUConverterPointer(clone);
+}
+
+auto file_header(const string& file_name)
+{
+	return "==> " + file_name + " <==\n";
+}
+
+/**
+ * @brief Checks many files with multiple threads, one file per thread.
+ *
+ * The worker threads take the files in order and check each one whole, with
+ * their own break iterator and input converter. The calling thread writes the
+ * output of the files in the order of the list, each after its header if
+ * headers is true. The number of files in flight is bounded. Without
+ * keep_going, it stops at the first file that can not be opened.
+ *
+ * @return the number of files that can not be opened.
+ */
+auto process_files_parallel(const Dictionary& dic,
+                            const vector<string>& files, UConverter* in_cnv,
+                            Text_Writer& out, bool headers, bool keep_going,
+                            const Check_Options& opt, Check_Result& r,
+                            size_t jobs) -> size_t
+{
+	struct File_Result {
+		Check_Result result;
+		bool opened = false;
+		bool done = false;
+	};
+	// The results of files from written_files to next_file, at most
+	// max_files of them.
+	auto max_files = jobs * 4;
+	auto results = deque<unique_ptr<File_Result>>();
+	auto next_file = size_t(0);    // index of the next file to check
+	auto written_files = size_t(0); // number of files written
+	auto mtx = mutex();
+	auto can_take = condition_variable();
+	auto file_done = condition_variable();
+
+	auto worker = [&]() {
+		auto cnv = clone_converter(in_cnv);
+		auto checker = Line_Checker(dic, opt);
+		for (;;) {
+			auto lock = unique_lock(mtx);
+			can_take.wait(lock, [&] {
+				return next_file == files.size() ||
+				       next_file - written_files < max_files;
+			});
+			if (next_file == files.size())
+				return;
+			auto i = next_file++;
+			results.push_back(make_unique<File_Result>());
+			auto& f = *results.back();
+			lock.unlock();
+			f.opened = with_file_source(files[i], [&](auto& src) {
+				process_text(checker, src, cnv.getAlias(),
+				             nullptr, {}, f.result);
+			});
+			lock.lock();
+			f.done = true;
+			file_done.notify_one();
+		}
+	};
+	auto threads = vector<thread>();
+	for (size_t i = 0; i != min(jobs, files.size()); ++i)
+		threads.emplace_back(worker);
+
+	auto failed = size_t(0);
+	for (auto& file_name : files) {
+		auto lock = unique_lock(mtx);
+		file_done.wait(lock, [&] {
+			return !results.empty() && results.front()->done;
+		});
+		auto f = std::move(results.front());
+		results.pop_front();
+		lock.unlock();
+		if (!f->opened) {
+			clog << "ERROR: Can't open " << file_name << '\n';
+			++failed;
+			if (!keep_going) {
+				lock.lock();
+				next_file = files.size();
+				can_take.notify_all();
+				break;
+			}
+		}
+		else if (!f->result.out.empty()) {
+			if (headers)
+				out.write(file_header(file_name));
+			out.write(f->result.out);
+		}
+		r.merge(f->result);
+		lock.lock();
+		++written_files;
+		can_take.notify_all();
+	}
+	for (auto& t : threads)
+		t.join();
+	return failed;
+}
+
+/**
+ * @brief Prints the summary of the checked input to the log.
+ *
+ * Without the number of files, the input was the standard input.
+ */
+auto print_summary(optional<size_t> num_files, const Check_Result& r,
+                   chrono::duration<double> time)
+{
+	auto sec = time.count();
+	auto per_sec = [&](size_t n) { return sec > 0 ? n / sec : 0.0; };
+	clog << "INFO: Checked ";
+	if (!num_files)
+		clog << "standard input";
+	else
+		clog << *num_files << (*num_files == 1 ? " file" : " files");
+	clog << ", " << r.bytes
+	     << " bytes, " << r.words << " words, " << r.misspelled
+	     << " misspelled in " << fixed << setprecision(3) << sec << " s, "
+	     << setprecision(0) << per_sec(r.words) << " words/s, "
+	     << setprecision(2) << per_sec(r.bytes) / 1e6 << " MB/s" << endl;
+}
+enum class Stats_Format { NONE, TEXT, JSON };
+
+/**
+ * @brief What is measured in main() for the statistics, option --stats.
+ */
+struct Run_Stats {
+	string dictionary;
+	chrono::duration<double> load_time = {};
+	chrono::duration<double> check_time = {};
+	optional<size_t> num_files; ///< empty if the input was standard input
+	bool unique_words = false;  ///< each distinct word was checked once
+};
+
+auto print_latency_text(string_view op, const Latency_Histogram& h)
+{
+	if (h.count() == 0)
+		return;
+	auto& o = clog;
+	o << "STATS: " << op << ' ' << h.count() << " calls, total "
+	  << setprecision(3) << chrono::duration<double>(h.total()).count()
+	  << " s, mean " << h.mean().count() << " ns, p50 < "
+	  << h.percentile(0.5).count() << " ns, p90 < "
+	  << h.percentile(0.9).count() << " ns, p99 < "
+	  << h.percentile(0.99).count() << " ns, max "
+	  << h.max_latency().count() << " ns\n";
+	h.for_each_bucket([&](chrono::nanoseconds upper, size_t n) {
+		o << "STATS: " << op << " latency < " << upper.count()
+		  << " ns: " << n << '\n';
+	});
+}
+
+auto print_latency_json(string_view op, const Latency_Histogram& h)
+{
+	auto& o = clog;
+	o << ",\"" << op << "\":{\"calls\":" << h.count() << ",\"total_s\":"
+	  << setprecision(6) << chrono::duration<double>(h.total()).count()
+	  << ",\"mean_ns\":" << h.mean().count()
+	  << ",\"p50_ns\":" << h.percentile(0.5).count()
+	  << ",\"p90_ns\":" << h.percentile(0.9).count()
+	  << ",\"p99_ns\":" << h.percentile(0.99).count()
+	  << ",\"max_ns\":" << h.max_latency().count() << ",\"histogram\":[";
+	auto sep = "";
+	h.for_each_bucket([&](chrono::nanoseconds upper, size_t n) {
+		o << sep << '[' << upper.count() << ',' << n << ']';
+		sep = ",";
+	});
+	o << "]}";
+}
+
+/**
+ * @brief Prints the statistics of the run to the log, option --stats.
+ *
+ * The text format has one line per number, the JSON format is one object on
+ * one line. The latency percentiles are upper bounds of histogram buckets.
+ */
+auto print_stats(Stats_Format format, const Run_Stats& s, const Check_Result& r)
+{
+	auto peak_rss = nuspell::get_peak_ram_usage();
+	auto check_sec = s.check_time.count();
+	auto words_per_sec = check_sec > 0 ? r.words / check_sec : 0.0;
+	auto unique = r.counts.size();
+	auto hit_rate = r.words ? 1.0 - double(unique) / r.words : 0.0;
+	auto& o = clog;
+	auto flags = o.flags();
+	o << fixed;
+	if (format == Stats_Format::TEXT) {
+		o << "STATS: dictionary load time " << setprecision(3)
+		  << s.load_time.count() << " s, peak RSS " << peak_rss
+		  << " KiB\n";
+		o << "STATS: check time " << check_sec << " s, " << r.words
+		  << " words, " << setprecision(0) << words_per_sec
+		  << " words/s\n";
+		if (s.unique_words)
+			o << "STATS: unique words " << unique << ", hit rate "
+			  << setprecision(2) << hit_rate * 100 << " %\n";
+		print_latency_text("spell", r.spell_latency);
+		print_latency_text("suggest", r.suggest_latency);
+	}
+	else {
+		auto dic = string();
+		append_json_string(s.dictionary, dic);
+		o << "{\"dictionary\":" << dic << ",\"load_time_s\":"
+		  << setprecision(6) << s.load_time.count()
+		  << ",\"peak_rss_kib\":" << peak_rss << ",\"files\":";
+		if (s.num_files)
+			o << *s.num_files;
+		else
+			o << "null";
+		o << ",\"bytes\":" << r.bytes << ",\"words\":" << r.words
+		  << ",\"misspelled\":" << r.misspelled
+		  << ",\"check_time_s\":" << check_sec
+		  << ",\"words_per_s\":" << words_per_sec;
+		if (s.unique_words)
+			o << ",\"unique_words\":" << unique
+			  << ",\"cache_hit_rate\":" << hit_rate;
+		print_latency_json("spell", r.spell_latency);
+		print_latency_json("suggest", r.suggest_latency);
+		o << "}\n";
+	}
+	o.flags(flags);
+	o.flush();
+}
 } // namespace
 int main(int argc, char* argv[])
 {
@@ -339,13 +1568,25 @@ int main(int argc, char* argv[])
 	auto dictionary = string();
 	auto input_enc = string();
 	auto output_enc = string();
+	auto jobs = size_t(1);
+	auto server_opt = Server_Options();
+	auto socket_path = string();
+	auto pipe_stats = 0;
+	auto allow_dict_paths = 0;
+	auto fast_tokenizer = false;
+	auto recursive = false;
+	auto filter = File_Filter();
+	auto stats_format = Stats_Format::NONE;
+	auto run_stats = Run_Stats();
+	auto use_dict_cache = false;
+	auto dict_cache_path = filesystem::path();
 
 	if (argc > 0 && argv[0])
 		program_name = argv[0];
 
 	ios_base::sync_with_stdio(false);
 
-	auto optstring = "d:D";
+	auto optstring = "ad:Dj:lLrU";
 	option longopts[] = {
 	    {"help", no_argument, &mode_int, Mode::HELP},
 	    {"version", no_argument, &mode_int, Mode::VERSION},
@@ -354,6 +1595,25 @@ int main(int argc, char* argv[])
 	    {"encoding", required_argument, nullptr, 'e'},
 	    {"input-encoding", required_argument, nullptr, 'i'},
 	    {"output-encoding", required_argument, nullptr, 'o'},
+	    {"jobs", required_argument, nullptr, 'j'},
+	    {"misspelled-words", no_argument, &mode_int, MISSPELLED_WORDS},
+	    {"misspelled-lines", no_argument, &mode_int, MISSPELLED_LINES},
+	    {"unique-misspelled-words", no_argument, &mode_int,
+	     UNIQUE_MISSPELLED},
+	    {"server", no_argument, &mode_int, Mode::SERVER},
+	    {"socket", required_argument, nullptr, 's'},
+	    {"deadline", required_argument, nullptr, 't'},
+	    {"max-dictionaries", required_argument, nullptr, 'm'},
+	    {"max-connections", required_argument, nullptr, 'M'},
+	    {"allow-dictionary-paths", no_argument, &allow_dict_paths, 1},
+	    {"client", required_argument, nullptr, 'c'},
+	    {"pipe-stats", no_argument, &pipe_stats, 1},
+	    {"tokenizer", required_argument, nullptr, 'k'},
+	    {"recursive", no_argument, nullptr, 'r'},
+	    {"include", required_argument, nullptr, 'n'},
+	    {"exclude", required_argument, nullptr, 'x'},
+	    {"stats", optional_argument, nullptr, 'S'},
+	    {"dictionary-cache", optional_argument, nullptr, 'C'},
 	    {}};
 	int longindex;
 	int c;
@@ -366,9 +1626,61 @@ int main(int argc, char* argv[])
 		case 'd':
 			dictionary = optarg;
 			break;
+		case 'a':
+			mode_int = Mode::PIPE;
+			break;
+		case 'k':
+			if (optarg == "fast"sv) {
+				fast_tokenizer = true;
+			}
+			else if (optarg == "icu"sv) {
+				fast_tokenizer = false;
+			}
+			else {
+				clog << "ERROR: Invalid tokenizer " << optarg
+				     << '\n';
+				return EXIT_FAILURE;
+			}
+			break;
 		case 'D':
 			mode_int = Mode::LIST_DICTS;
 			break;
+		case 'l':
+			mode_int = Mode::MISSPELLED_WORDS;
+			break;
+		case 'L':
+			mode_int = Mode::MISSPELLED_LINES;
+			break;
+		case 'U':
+			mode_int = Mode::UNIQUE_MISSPELLED;
+			break;
+		case 'r':
+			recursive = true;
+			break;
+		case 'n':
+			filter.include.push_back(optarg);
+			break;
+		case 'x':
+			filter.exclude.push_back(optarg);
+			break;
+		case 'C':
+			use_dict_cache = true;
+			if (optarg)
+				dict_cache_path = optarg;
+			break;
+		case 'S':
+			if (!optarg || optarg == "text"sv) {
+				stats_format = Stats_Format::TEXT;
+			}
+			else if (optarg == "json"sv) {
+				stats_format = Stats_Format::JSON;
+			}
+			else {
+				clog << "ERROR: Invalid statistics format "
+				     << optarg << '\n';
+				return EXIT_FAILURE;
+			}
+			break;
 		case 'e':
 			input_enc = optarg;
 			output_enc = optarg;
@@ -379,6 +1691,54 @@ int main(int argc, char* argv[])
 		case 'o':
 			output_enc = optarg;
 			break;
+		case 's':
+			server_opt.socket_path = optarg;
+			break;
+		case 'c':
+			mode_int = Mode::CLIENT;
+			socket_path = optarg;
+			break;
+		case 't': {
+			auto arg = string_view(optarg);
+			auto arg_end = arg.data() + arg.size();
+			auto ms = 0u;
+			auto [ptr, ec] = from_chars(arg.data(), arg_end, ms);
+			if (ec != errc() || ptr != arg_end) {
+				clog << "ERROR: Invalid deadline " << arg
+				     << '\n';
+				return EXIT_FAILURE;
+			}
+			server_opt.deadline = chrono::milliseconds(ms);
+			break;
+		}
+		case 'm':
+		case 'M': {
+			auto arg = string_view(optarg);
+			auto arg_end = arg.data() + arg.size();
+			auto n = size_t(0);
+			auto [ptr, ec] = from_chars(arg.data(), arg_end, n);
+			if (ec != errc() || ptr != arg_end || n == 0) {
+				clog << "ERROR: Invalid maximum " << arg
+				     << '\n';
+				return EXIT_FAILURE;
+			}
+			if (c == 'm')
+				server_opt.max_dictionaries = n;
+			else
+				server_opt.max_connections = n;
+			break;
+		}
+		case 'j': {
+			auto arg = string_view(optarg);
+			auto arg_end = arg.data() + arg.size();
+			auto [ptr, ec] = from_chars(arg.data(), arg_end, jobs);
+			if (ec != errc() || ptr != arg_end || jobs == 0) {
+				clog << "ERROR: Invalid number of jobs " << arg
+				     << '\n';
+				return EXIT_FAILURE;
+			}
+			break;
+		}
 		case '?':
 			return EXIT_FAILURE;
 		}
@@ -392,7 +1752,16 @@ int main(int argc, char* argv[])
 		print_help(program_name);
 		return 0;
 	}
-	auto f = Dict_Finder_For_CLI_Tool_2();
+	else if (mode == Mode::CLIENT) {
+		return run_client(socket_path);
+	}
+	auto f = CLI_Dict_Finder();
+	if (use_dict_cache && dict_cache_path.empty())
+		dict_cache_path = nuspell::get_default_dict_cache_path();
+	if (use_dict_cache && dict_cache_path.empty())
+		clog << "WARNING: Unknown path of the dictionary cache\n";
+	else if (use_dict_cache)
+		f.use_cache(dict_cache_path);
 	if (mode == Mode::LIST_DICTS) {
 		list_dictionaries(f);
 		return 0;
@@ -470,6 +1839,7 @@ int main(int argc, char* argv[])
 	}
 	clog << "INFO: Pointed dictionary " << filename.string() << endl;
 	auto dic = Dictionary();
+	auto load_start = chrono::steady_clock::now();
 	try {
 		dic.load_aff_dic_internal(filename, clog);
 	}
@@ -477,6 +1847,15 @@ int main(int argc, char* argv[])
 		clog << "ERROR: " << e.what() << '\n';
 		return EXIT_FAILURE;
 	}
+	run_stats.dictionary = filename.string();
+	run_stats.load_time = chrono::steady_clock::now() - load_start;
+	if (mode == Mode::SERVER) {
+		// requests and responses are JSON, always in UTF-8
+		server_opt.jobs = jobs;
+		server_opt.allow_dictionary_paths = allow_dict_paths;
+		return run_server(make_unique<Dictionary>(std::move(dic)),
+		                  dictionary, f, server_opt);
+	}
 	// ICU reports all types of errors, logic errors and runtime errors
 	// using this enum. We should not check for logic errors, they should
 	// not happened. Optionally, only assert that they are not there can be
@@ -518,21 +1897,101 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	if (mode == Mode::PIPE) {
+		if (optind != argc) {
+			clog << "ERROR: Unexpected argument " << argv[optind]
+			     << '\n';
+			return EXIT_FAILURE;
+		}
+		auto out = Text_Writer(cout, out_ucnv);
+		// the name of a dictionary is usually its language tag
+		auto locale = icu::Locale(filename.stem().string().c_str());
+		run_pipe(dic, cin, in_ucnv.getAlias(), locale, out,
+		         fast_tokenizer, pipe_stats);
+		return 0;
+	}
+	auto opt = Check_Options();
+	opt.mode = mode;
+	opt.fast_tokenizer = fast_tokenizer;
+	opt.stats = stats_format != Stats_Format::NONE;
+	// With the same encoding, the lines are written as they were read, so
+	// invalid input is not replaced. Only -L writes the input.
+	opt.raw_lines = mode == Mode::MISSPELLED_LINES &&
+	                string_view(ucnv_getName(in_ucnv.getAlias(), &uerr)) ==
+	                    ucnv_getName(out_ucnv, &uerr);
+	auto out = Text_Writer(cout, opt.raw_lines ? nullptr : out_ucnv);
+	auto r = Check_Result();
+	auto ok = true;
+	auto& num_files = run_stats.num_files;
+	auto start = chrono::steady_clock::now();
+	auto checker = Line_Checker(dic, opt);
 	if (optind == argc) {
-		process_text(dic, cin, in_ucnv.getAlias(), cout, out_ucnv,
-		             uerr);
+		if (mode == Mode::NORMAL)
+			cout << "Enter some text: ";
+		if (is_terminal_input())
+			process_lines(checker, cin, in_ucnv.getAlias(), out, r);
+		else if (jobs == 1)
+			process_text(checker, cin, in_ucnv.getAlias(), &out, {},
+			             r);
+		else
+			process_text_parallel(dic, cin, in_ucnv.getAlias(), out,
+			                      {}, opt, r, jobs);
 	}
 	else {
+		auto files = vector<string>();
 		for (; optind != argc; ++optind) {
-			auto file_name = argv[optind];
-			ifstream in(file_name);
-			if (!in.is_open()) {
-				clog << "ERROR: Can't open " << file_name
-				     << '\n';
-				return EXIT_FAILURE;
+			auto arg = argv[optind];
+			auto ec = error_code();
+			if (recursive && filesystem::is_directory(arg, ec))
+				ok = append_dir_files(arg, filter, files) && ok;
+			else
+				files.push_back(arg);
+		}
+		// With -r, the output of each file is grouped under a header
+		// with its name and a file that can not be opened does not
+		// stop the others.
+		num_files = files.size();
+		if (jobs != 1 && files.size() > 1) {
+			auto failed = process_files_parallel(
+			    dic, files, in_ucnv.getAlias(), out, recursive,
+			    recursive, opt, r, jobs);
+			*num_files -= failed;
+			ok = ok && failed == 0;
+		}
+		else {
+			auto header = string();
+			auto process = [&](auto& src) {
+				auto cnv = in_ucnv.getAlias();
+				if (jobs == 1)
+					process_text(checker, src, cnv, &out,
+					             header, r);
+				else
+					process_text_parallel(dic, src, cnv,
+					                      out, header, opt,
+					                      r, jobs);
+			};
+			for (auto& file_name : files) {
+				if (recursive)
+					header = file_header(file_name);
+				if (!with_file_source(file_name, process)) {
+					clog << "ERROR: Can't open "
+					     << file_name << '\n';
+					--*num_files;
+					ok = false;
+					if (!recursive)
+						break;
+				}
 			}
-			process_text(dic, in, in_ucnv.getAlias(), cout,
-			             out_ucnv, uerr);
 		}
 	}
+	if (mode == Mode::UNIQUE_MISSPELLED)
+		print_unique_misspelled(checker, r, out);
+	out.flush();
+	run_stats.check_time = chrono::steady_clock::now() - start;
+	run_stats.unique_words = mode == Mode::UNIQUE_MISSPELLED;
+	if (recursive)
+		print_summary(num_files, r, run_stats.check_time);
+	if (stats_format != Stats_Format::NONE)
+		print_stats(stats_format, run_stats, r);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,1104 @@
+/* Copyright 2016-2024 Dimitrij Mijoski
+ *
+ * This file is part of Nuspell.
+ *
+ * Nuspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nuspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "server.hxx"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#if __has_include(<unistd.h>)
+#include <unistd.h> // defines _POSIX_VERSION
+#endif
+#ifdef _POSIX_VERSION
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+using namespace std;
+using nuspell::Dictionary, nuspell::Dictionary_Loading_Error;
+
+namespace {
+using Clock = chrono::steady_clock;
+
+constexpr size_t max_request_size = 1024 * 1024;
+// responses kept for a client that does not read them
+constexpr size_t max_pending_size = 16 * 1024 * 1024;
+constexpr auto max_deadline = chrono::milliseconds(chrono::hours(24));
+
+/**
+ * @brief Minimal JSON value, enough for the requests of the server.
+ *
+ * Numbers keep their text, so they are written back exactly as received.
+ */
+struct Json_Value {
+	enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+	Type type = NUL;
+	bool boolean = false;
+	string str; // the string or the text of the number
+	vector<Json_Value> array;
+	vector<pair<string, Json_Value>> object;
+
+	auto find(string_view key) const -> const Json_Value*
+	{
+		for (auto& [k, v] : object)
+			if (k == key)
+				return &v;
+		return nullptr;
+	}
+};
+
+auto append_utf8(char32_t cp, string& out)
+{
+	if (cp < 0x80) {
+		out += char(cp);
+	}
+	else if (cp < 0x800) {
+		out += char(0xC0 | (cp >> 6));
+		out += char(0x80 | (cp & 0x3F));
+	}
+	else if (cp < 0x10000) {
+		out += char(0xE0 | (cp >> 12));
+		out += char(0x80 | ((cp >> 6) & 0x3F));
+		out += char(0x80 | (cp & 0x3F));
+	}
+	else {
+		out += char(0xF0 | (cp >> 18));
+		out += char(0x80 | ((cp >> 12) & 0x3F));
+		out += char(0x80 | ((cp >> 6) & 0x3F));
+		out += char(0x80 | (cp & 0x3F));
+	}
+}
+
+/**
+ * @brief Parser of JSON text as defined in RFC 8259.
+ *
+ * The strings are not validated as UTF-8, the dictionary handles that.
+ */
+class Json_Parser {
+	string_view s;
+	size_t i = 0;
+	size_t depth = 0;
+
+	auto skip_space()
+	{
+		while (i != s.size() &&
+		       (s[i] == ' ' || s[i] == '\t' || s[i] == '\n' ||
+		        s[i] == '\r'))
+			++i;
+	}
+	auto is_digit() const
+	{
+		return i != s.size() && '0' <= s[i] && s[i] <= '9';
+	}
+	auto parse_literal(string_view lit) -> bool
+	{
+		if (s.substr(i, lit.size()) != lit)
+			return false;
+		i += lit.size();
+		return true;
+	}
+	auto parse_hex4(char32_t& cp) -> bool
+	{
+		if (s.size() - i < 4)
+			return false;
+		cp = 0;
+		for (auto end = i + 4; i != end; ++i) {
+			auto c = s[i];
+			cp <<= 4;
+			if ('0' <= c && c <= '9')
+				cp |= c - '0';
+			else if ('a' <= c && c <= 'f')
+				cp |= c - 'a' + 10;
+			else if ('A' <= c && c <= 'F')
+				cp |= c - 'A' + 10;
+			else
+				return false;
+		}
+		return true;
+	}
+	auto parse_escape(string& out) -> bool
+	{
+		if (i == s.size())
+			return false;
+		auto c = s[i++];
+		switch (c) {
+		case '"':
+		case '\\':
+		case '/':
+			out += c;
+			return true;
+		case 'b':
+			out += '\b';
+			return true;
+		case 'f':
+			out += '\f';
+			return true;
+		case 'n':
+			out += '\n';
+			return true;
+		case 'r':
+			out += '\r';
+			return true;
+		case 't':
+			out += '\t';
+			return true;
+		case 'u':
+			break;
+		default:
+			return false;
+		}
+		auto cp = char32_t();
+		if (!parse_hex4(cp))
+			return false;
+		if (0xDC00 <= cp && cp <= 0xDFFF)
+			return false;
+		if (0xD800 <= cp && cp <= 0xDBFF) {
+			auto low = char32_t();
+			if (!parse_literal("\\u") || !parse_hex4(low) ||
+			    low < 0xDC00 || low > 0xDFFF)
+				return false;
+			cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+		}
+		append_utf8(cp, out);
+		return true;
+	}
+	auto parse_string(string& out) -> bool
+	{
+		if (!parse_literal("\""))
+			return false;
+		out.clear();
+		while (i != s.size()) {
+			auto c = s[i++];
+			if (c == '"')
+				return true;
+			if (static_cast<unsigned char>(c) < 0x20)
+				return false;
+			if (c != '\\')
+				out += c;
+			else if (!parse_escape(out))
+				return false;
+		}
+		return false;
+	}
+	auto parse_number(string& out) -> bool
+	{
+		auto first = i;
+		if (i != s.size() && s[i] == '-')
+			++i;
+		if (i != s.size() && s[i] == '0')
+			++i;
+		else if (is_digit())
+			while (is_digit())
+				++i;
+		else
+			return false;
+		if (i != s.size() && s[i] == '.') {
+			++i;
+			if (!is_digit())
+				return false;
+			while (is_digit())
+				++i;
+		}
+		if (i != s.size() && (s[i] == 'e' || s[i] == 'E')) {
+			++i;
+			if (i != s.size() && (s[i] == '+' || s[i] == '-'))
+				++i;
+			if (!is_digit())
+				return false;
+			while (is_digit())
+				++i;
+		}
+		out = s.substr(first, i - first);
+		return true;
+	}
+	auto parse_array(Json_Value& v) -> bool
+	{
+		++i; // [
+		skip_space();
+		if (parse_literal("]"))
+			return true;
+		do {
+			if (!parse_value(v.array.emplace_back()))
+				return false;
+			skip_space();
+		} while (parse_literal(","));
+		return parse_literal("]");
+	}
+	auto parse_object(Json_Value& v) -> bool
+	{
+		++i; // {
+		skip_space();
+		if (parse_literal("}"))
+			return true;
+		do {
+			skip_space();
+			auto& [key, val] = v.object.emplace_back();
+			if (!parse_string(key))
+				return false;
+			skip_space();
+			if (!parse_literal(":") || !parse_value(val))
+				return false;
+			skip_space();
+		} while (parse_literal(","));
+		return parse_literal("}");
+	}
+	auto parse_value(Json_Value& v) -> bool
+	{
+		skip_space();
+		if (i == s.size() || depth == 64)
+			return false;
+		switch (s[i]) {
+		case 'n':
+			v.type = v.NUL;
+			return parse_literal("null");
+		case 't':
+			v.type = v.BOOLEAN;
+			v.boolean = true;
+			return parse_literal("true");
+		case 'f':
+			v.type = v.BOOLEAN;
+			v.boolean = false;
+			return parse_literal("false");
+		case '"':
+			v.type = v.STRING;
+			return parse_string(v.str);
+		case '[': {
+			v.type = v.ARRAY;
+			++depth;
+			auto ok = parse_array(v);
+			--depth;
+			return ok;
+		}
+		case '{': {
+			v.type = v.OBJECT;
+			++depth;
+			auto ok = parse_object(v);
+			--depth;
+			return ok;
+		}
+		default:
+			v.type = v.NUMBER;
+			return parse_number(v.str);
+		}
+	}
+
+      public:
+	/**
+	 * @brief Parses the whole text as one JSON value.
+	 */
+	auto parse(string_view text, Json_Value& v) -> bool
+	{
+		s = text;
+		i = 0;
+		depth = 0;
+		v = Json_Value();
+		if (!parse_value(v))
+			return false;
+		skip_space();
+		return i == s.size();
+	}
+};
+} // namespace
+
+/**
+ * @brief Appends a string to out as a JSON string literal, escaping it.
+ */
+auto append_json_string(string_view str, string& out) -> void
+{
+	out += '"';
+	for (auto c : str) {
+		switch (c) {
+		case '"':
+			out += "\\\"";
+			break;
+		case '\\':
+			out += "\\\\";
+			break;
+		case '\n':
+			out += "\\n";
+			break;
+		case '\r':
+			out += "\\r";
+			break;
+		case '\t':
+			out += "\\t";
+			break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				char buf[8];
+				snprintf(buf, sizeof(buf), "\\u%04x", c);
+				out += buf;
+			}
+			else {
+				out += c;
+			}
+		}
+	}
+	out += '"';
+}
+
+/**
+ * @brief Finds the dictionaries in the search paths through a cache.
+ *
+ * After this call get_dictionaries() and get_dictionary_path() use the
+ * dictionaries found with search_dirs_for_dicts_cached().
+ *
+ * @param cache_path path to the cache file.
+ */
+auto CLI_Dict_Finder::use_cache(const filesystem::path& cache_path) -> void
+{
+	cached_dicts.clear();
+	nuspell::search_dirs_for_dicts_cached(get_dir_paths(), cache_path,
+	                                      cached_dicts);
+	use_cached_dicts = true;
+}
+
+/**
+ * @brief Gets the paths to the .aff files of all dictionaries in the search
+ * paths.
+ */
+auto CLI_Dict_Finder::get_dictionaries() const -> vector<filesystem::path>
+{
+	if (use_cached_dicts)
+		return cached_dicts;
+	auto dicts = vector<filesystem::path>();
+	nuspell::search_dirs_for_dicts(get_dir_paths(), dicts);
+	return dicts;
+}
+
+auto CLI_Dict_Finder::get_dictionary_path(const filesystem::path& dict) const
+    -> filesystem::path
+{
+	if (use_cached_dicts && dict.has_stem() &&
+	    distance(begin(dict), end(dict)) == 1) {
+		auto it = find_if(begin(cached_dicts), end(cached_dicts),
+		                  [&](auto& p) { return p.stem() == dict; });
+		if (it != end(cached_dicts) && filesystem::is_regular_file(*it))
+			return *it;
+	}
+	return finder.get_dictionary_path(dict);
+}
+
+namespace {
+auto append_json(const Json_Value& v, string& out) -> void
+{
+	switch (v.type) {
+	case v.NUL:
+		out += "null";
+		break;
+	case v.BOOLEAN:
+		out += v.boolean ? "true" : "false";
+		break;
+	case v.NUMBER:
+		out += v.str;
+		break;
+	case v.STRING:
+		append_json_string(v.str, out);
+		break;
+	case v.ARRAY:
+		out += '[';
+		for (auto& x : v.array) {
+			if (&x != &v.array.front())
+				out += ',';
+			append_json(x, out);
+		}
+		out += ']';
+		break;
+	case v.OBJECT:
+		out += '{';
+		for (auto& [key, x] : v.object) {
+			if (&key != &v.object.front().first)
+				out += ',';
+			append_json_string(key, out);
+			out += ':';
+			append_json(x, out);
+		}
+		out += '}';
+		break;
+	}
+}
+
+auto append_json_strings(const vector<string>& strs, string& out)
+{
+	out += '[';
+	for (auto& x : strs) {
+		if (&x != &strs.front())
+			out += ',';
+		append_json_string(x, out);
+	}
+	out += ']';
+}
+
+/**
+ * @brief Checks if a dictionary given in a request is a name, not a path.
+ *
+ * Names are searched in the dictionary directories like with the option -d,
+ * so a client can not make the server open other files.
+ */
+auto is_dictionary_name(string_view name)
+{
+	return !name.empty() && name != "." && name != ".." &&
+	       name.find_first_of("/\\") == name.npos;
+}
+
+/**
+ * @brief Dictionaries that stay loaded for the lifetime of the server.
+ *
+ * The dictionary given on the command line is the default one. Others are
+ * loaded on first use, by name, or also by path if allowed, the same way as
+ * with the option -d. At most max_dicts are loaded, including those that are
+ * being loaded.
+ */
+class Dictionary_Pool {
+	CLI_Dict_Finder finder;
+	string default_name;
+	size_t max_dicts;
+	bool allow_paths;
+	mutex mtx;
+	unordered_map<string, unique_ptr<Dictionary>> dicts;
+	size_t num_loading = 0;
+
+      public:
+	Dictionary_Pool(unique_ptr<Dictionary> dic, const string& name,
+	                const CLI_Dict_Finder& finder,
+	                const Server_Options& opt)
+	    : finder(finder), default_name(name),
+	      max_dicts(opt.max_dictionaries),
+	      allow_paths(opt.allow_dictionary_paths)
+	{
+		dicts.emplace(name, std::move(dic));
+	}
+	auto get(const Json_Value* name, string& error) -> const Dictionary*
+	{
+		if (name && name->type != name->STRING) {
+			error = "dictionary must be a string";
+			return nullptr;
+		}
+		auto& key = name ? name->str : default_name;
+		{
+			auto lock = lock_guard(mtx);
+			auto it = dicts.find(key);
+			if (it != end(dicts))
+				return it->second.get();
+			if (!allow_paths && !is_dictionary_name(key)) {
+				error = "dictionary must be a name";
+				return nullptr;
+			}
+			if (dicts.size() + num_loading >= max_dicts) {
+				error = "too many dictionaries";
+				return nullptr;
+			}
+			++num_loading;
+		}
+		// Load without holding the lock, so the requests for other
+		// dictionaries are not blocked.
+		auto dic = make_unique<Dictionary>();
+		auto path = finder.get_dictionary_path(key);
+		if (path.empty()) {
+			error = "dictionary " + key + " not found";
+			dic = nullptr;
+		}
+		else {
+			try {
+				dic->load_aff_dic_internal(path, clog);
+			}
+			catch (const Dictionary_Loading_Error& e) {
+				error = e.what();
+				dic = nullptr;
+			}
+		}
+		auto lock = lock_guard(mtx);
+		--num_loading;
+		if (!dic)
+			return nullptr;
+		auto& d = dicts[key];
+		if (!d) {
+			clog << "INFO: Loaded dictionary " << path.string()
+			     << endl;
+			d = std::move(dic);
+		}
+		return d.get();
+	}
+};
+
+/**
+ * @brief Fixed number of threads that run jobs from a bounded queue.
+ *
+ * push() blocks while the queue is full, which slows down reading of new
+ * requests when the workers can not keep up. The destructor waits for the
+ * remaining jobs.
+ */
+class Worker_Pool {
+	mutex mtx;
+	condition_variable not_empty;
+	condition_variable not_full;
+	deque<function<void()>> jobs;
+	size_t capacity;
+	bool closing = false;
+	vector<thread> threads;
+
+	auto work() -> void
+	{
+		for (;;) {
+			auto lock = unique_lock(mtx);
+			not_empty.wait(
+			    lock, [&] { return closing || !jobs.empty(); });
+			if (jobs.empty())
+				return;
+			auto job = std::move(jobs.front());
+			jobs.pop_front();
+			not_full.notify_one();
+			lock.unlock();
+			job();
+		}
+	}
+
+      public:
+	Worker_Pool(size_t num_threads, size_t capacity) : capacity(capacity)
+	{
+		for (size_t i = 0; i != num_threads; ++i)
+			threads.emplace_back([this] { work(); });
+	}
+	~Worker_Pool()
+	{
+		{
+			auto lock = lock_guard(mtx);
+			closing = true;
+		}
+		not_empty.notify_all();
+		for (auto& t : threads)
+			t.join();
+	}
+	Worker_Pool(const Worker_Pool&) = delete;
+	auto operator=(const Worker_Pool&) -> Worker_Pool& = delete;
+	auto push(function<void()> job) -> void
+	{
+		auto lock = unique_lock(mtx);
+		not_full.wait(lock, [&] { return jobs.size() < capacity; });
+		jobs.push_back(std::move(job));
+		not_empty.notify_one();
+	}
+};
+
+/**
+ * @brief Where the responses to the requests of one client are written.
+ *
+ * Each response is one line, written whole. The responses can be in a
+ * different order than the requests, the client matches them by id.
+ */
+class Response_Writer {
+      protected:
+	mutex mtx;
+
+	virtual auto write_locked(const string& line) -> void = 0;
+
+      public:
+	virtual ~Response_Writer() = default;
+	auto write(const string& line) -> void
+	{
+		auto lock = lock_guard(mtx);
+		write_locked(line);
+	}
+};
+
+class Stream_Writer : public Response_Writer {
+	ostream& out;
+
+	auto write_locked(const string& line) -> void override
+	{
+		out << line << flush;
+	}
+
+      public:
+	explicit Stream_Writer(ostream& out) : out(out) {}
+};
+
+auto is_expired(Clock::time_point deadline)
+{
+	return deadline != Clock::time_point() && Clock::now() > deadline;
+}
+
+/**
+ * @brief Executes one request and returns the response line.
+ */
+auto handle_request(Dictionary_Pool& dicts, const Json_Value& req,
+                    Clock::time_point deadline) -> string
+{
+	auto out = string("{\"id\":");
+	auto id = req.find("id");
+	if (id)
+		append_json(*id, out);
+	else
+		out += "null";
+	auto error = [&](string_view message) {
+		out += ",\"error\":";
+		append_json_string(message, out);
+		out += "}\n";
+		return out;
+	};
+	if (is_expired(deadline))
+		return error("deadline exceeded");
+	auto cmd = req.find("cmd");
+	if (!cmd || cmd->type != cmd->STRING)
+		return error("missing cmd");
+	auto err = string();
+	auto dic = dicts.get(req.find("dictionary"), err);
+	if (!dic)
+		return error(err);
+	// loading a dictionary can take long
+	if (is_expired(deadline))
+		return error("deadline exceeded");
+	auto suggestions = vector<string>();
+	if (cmd->str == "spell" || cmd->str == "suggest") {
+		auto word = req.find("word");
+		if (!word || word->type != word->STRING)
+			return error("missing word");
+		if (cmd->str == "spell") {
+			out += ",\"correct\":";
+			out += dic->spell(word->str) ? "true" : "false";
+		}
+		else {
+			dic->suggest(word->str, suggestions);
+			out += ",\"suggestions\":";
+			append_json_strings(suggestions, out);
+		}
+	}
+	else if (cmd->str == "check") {
+		auto words = req.find("words");
+		if (!words || words->type != words->ARRAY)
+			return error("missing words");
+		auto sug = req.find("suggest");
+		auto with_sugs = !sug || sug->type != sug->BOOLEAN ||
+		                 sug->boolean;
+		auto results = string();
+		for (auto& w : words->array) {
+			if (w.type != w.STRING)
+				return error("words must be strings");
+			if (is_expired(deadline))
+				return error("deadline exceeded");
+			if (!results.empty())
+				results += ',';
+			auto correct = dic->spell(w.str);
+			results += correct ? "{\"correct\":true"
+			                   : "{\"correct\":false";
+			if (!correct && with_sugs) {
+				dic->suggest(w.str, suggestions);
+				results += ",\"suggestions\":";
+				append_json_strings(suggestions, results);
+			}
+			results += '}';
+		}
+		out += ",\"results\":[";
+		out += results;
+		out += ']';
+	}
+	else {
+		return error("unknown cmd");
+	}
+	out += "}\n";
+	return out;
+}
+
+struct Server_State {
+	Dictionary_Pool dicts;
+	Worker_Pool pool;
+	chrono::milliseconds deadline;
+	size_t max_connections;
+	mutex conn_mtx = {};
+	condition_variable conn_done = {};
+	size_t num_connections = 0;
+};
+
+/**
+ * @brief Parses one request line and queues it for the workers.
+ */
+auto submit_request(string_view line,
+                    const shared_ptr<Response_Writer>& writer,
+                    const shared_ptr<Server_State>& state)
+{
+	if (line.find_first_not_of(" \t\r") == line.npos)
+		return;
+	auto req = Json_Value();
+	if (!Json_Parser().parse(line, req) || req.type != req.OBJECT) {
+		writer->write("{\"id\":null,\"error\":\"invalid request\"}\n");
+		return;
+	}
+	// A request can shorten the default deadline, but not remove it or
+	// make it longer.
+	auto ms = state->deadline;
+	auto d = req.find("deadline_ms");
+	if (d && d->type == d->NUMBER) {
+		auto max_ms = ms.count() > 0 ? ms : max_deadline;
+		auto req_ms = strtoll(d->str.c_str(), nullptr, 10);
+		if (req_ms > 0)
+			ms = min(chrono::milliseconds(req_ms), max_ms);
+	}
+	auto deadline = Clock::time_point();
+	if (ms.count() > 0)
+		deadline = Clock::now() + ms;
+	// The jobs must not own the state, the state owns the jobs.
+	auto dicts = &state->dicts;
+	state->pool.push([=, req = std::move(req)] {
+		writer->write(handle_request(*dicts, req, deadline));
+	});
+}
+
+auto serve_stdio(const shared_ptr<Server_State>& state)
+{
+	// the workers write to cout while this thread reads cin
+	cin.tie(nullptr);
+	auto writer = make_shared<Stream_Writer>(cout);
+	auto line = string();
+	while (getline(cin, line))
+		submit_request(line, writer, state);
+}
+
+#ifdef _POSIX_VERSION
+auto send_all(int fd, string_view data) -> bool
+{
+	while (!data.empty()) {
+		auto n = send(fd, data.data(), data.size(), 0);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		data.remove_prefix(n);
+	}
+	return true;
+}
+
+/**
+ * @brief Calls func for each complete line in buf and removes them from it.
+ */
+template <class Func>
+auto take_lines(string& buf, Func& func)
+{
+	auto start = size_t(0);
+	for (auto nl = buf.find('\n'); nl != buf.npos;
+	     nl = buf.find('\n', start)) {
+		func(string_view(buf).substr(start, nl - start));
+		start = nl + 1;
+	}
+	buf.erase(0, start);
+}
+
+/**
+ * @brief Reads lines from a socket until the peer stops sending.
+ */
+template <class Func>
+auto for_each_socket_line(int fd, Func func) -> bool
+{
+	auto buf = string();
+	char chunk[4096];
+	for (;;) {
+		auto n = recv(fd, chunk, sizeof(chunk), 0);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		buf.append(chunk, n);
+		take_lines(buf, func);
+		if (buf.size() > max_request_size)
+			return false;
+	}
+	func(string_view(buf));
+	return true;
+}
+
+/**
+ * @brief Writer to a connected socket that never blocks the workers.
+ *
+ * What the socket does not take at once is kept and sent later by the
+ * connection thread with flush(). A client that does not read its responses
+ * is disconnected when too much is kept. The socket is closed when the last
+ * response is written and the client does not send more requests.
+ */
+class Socket_Writer : public Response_Writer {
+	int fd;
+	string pending;
+	bool broken = false;
+
+	auto disconnect() -> void
+	{
+		broken = true;
+		pending.clear();
+		shutdown(fd, SHUT_RDWR);
+	}
+	auto send_pending() -> void
+	{
+		auto sent = size_t(0);
+		while (sent != pending.size()) {
+			auto n = send(fd, pending.data() + sent,
+			              pending.size() - sent, MSG_DONTWAIT);
+			if (n == -1 && errno == EINTR)
+				continue;
+			if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				break;
+			if (n <= 0)
+				return disconnect();
+			sent += n;
+		}
+		pending.erase(0, sent);
+		if (pending.size() > max_pending_size)
+			disconnect();
+	}
+	auto write_locked(const string& line) -> void override
+	{
+		if (broken)
+			return;
+		pending += line;
+		send_pending();
+	}
+
+      public:
+	explicit Socket_Writer(int fd) : fd(fd) {}
+	~Socket_Writer() override { close(fd); }
+
+	/**
+	 * @brief Sends what was kept, if the socket takes it.
+	 * @return true if something is still kept.
+	 */
+	auto flush() -> bool
+	{
+		auto lock = lock_guard(mtx);
+		if (!broken)
+			send_pending();
+		return !pending.empty();
+	}
+};
+
+/**
+ * @brief Reads the requests of one client and sends the responses that the
+ * workers could not send at once.
+ *
+ * It returns when the client stops sending and all its responses are sent,
+ * or when the client goes away.
+ */
+auto serve_connection(int fd, shared_ptr<Server_State> state)
+{
+	{
+		auto writer = make_shared<Socket_Writer>(fd);
+		auto submit = [&](string_view line) {
+			submit_request(line, writer, state);
+		};
+		auto too_large = "{\"id\":null,\"error\":"
+		                 "\"request too large\"}\n";
+		auto buf = string();
+		char chunk[4096];
+		auto reading = true;
+		auto has_pending = false;
+		// the jobs of the workers hold the other references
+		while (reading || has_pending || writer.use_count() != 1) {
+			auto p = pollfd();
+			p.fd = fd;
+			p.events = (reading ? POLLIN : 0) |
+			           (has_pending ? POLLOUT : 0);
+			if (poll(&p, 1, 100) == -1 && errno != EINTR)
+				break;
+			if (!reading && (p.revents & (POLLHUP | POLLERR)))
+				break;
+			if (reading && p.revents) {
+				auto n = recv(fd, chunk, sizeof(chunk), 0);
+				if (n > 0) {
+					buf.append(chunk, n);
+					take_lines(buf, submit);
+				}
+				else if (n == 0 || errno != EINTR) {
+					submit(buf);
+					reading = false;
+				}
+				if (buf.size() > max_request_size) {
+					writer->write(too_large);
+					reading = false;
+				}
+			}
+			has_pending = writer->flush();
+		}
+	}
+	{
+		auto lock = lock_guard(state->conn_mtx);
+		--state->num_connections;
+	}
+	state->conn_done.notify_one();
+}
+
+// The socket to remove when the server is stopped by a signal.
+char socket_to_remove[sizeof(sockaddr_un::sun_path)];
+
+extern "C" void remove_socket_and_exit(int sig)
+{
+	unlink(socket_to_remove);
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+auto serve_socket(const string& path, const shared_ptr<Server_State>& state)
+    -> int
+{
+	auto addr = sockaddr_un();
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path)) {
+		clog << "ERROR: Socket path " << path << " is too long\n";
+		return EXIT_FAILURE;
+	}
+	path.copy(addr.sun_path, path.size());
+	auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1) {
+		clog << "ERROR: Can't create socket: " << strerror(errno)
+		     << '\n';
+		return EXIT_FAILURE;
+	}
+	// remove the socket left by a previous server, but nothing else
+	struct stat st;
+	if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path.c_str());
+	// only the user that runs the server can connect
+	auto old_mask = umask(0077);
+	auto bound =
+	    bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != -1;
+	umask(old_mask);
+	if (!bound || listen(fd, SOMAXCONN) == -1) {
+		clog << "ERROR: Can't listen on " << path << ": "
+		     << strerror(errno) << '\n';
+		if (bound)
+			unlink(path.c_str());
+		close(fd);
+		return EXIT_FAILURE;
+	}
+	path.copy(socket_to_remove, path.size());
+	signal(SIGINT, remove_socket_and_exit);
+	signal(SIGTERM, remove_socket_and_exit);
+	// writing to a client that went away must not kill the server
+	signal(SIGPIPE, SIG_IGN);
+	clog << "INFO: Listening on " << path << endl;
+	for (;;) {
+		{
+			auto lock = unique_lock(state->conn_mtx);
+			state->conn_done.wait(lock, [&] {
+				return state->num_connections <
+				       state->max_connections;
+			});
+		}
+		auto conn = accept(fd, nullptr, nullptr);
+		if (conn == -1) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			clog << "ERROR: Can't accept connection: "
+			     << strerror(errno) << '\n';
+			unlink(path.c_str());
+			close(fd);
+			return EXIT_FAILURE;
+		}
+		{
+			auto lock = lock_guard(state->conn_mtx);
+			++state->num_connections;
+		}
+		thread(serve_connection, conn, state).detach();
+	}
+}
+#endif
+} // namespace
+
+/**
+ * @brief Serves requests until the input ends or forever with a socket.
+ *
+ * The requests and responses are JSON objects, one per line. The requests go
+ * to a pool of worker threads, so the responses can come in any order.
+ */
+auto run_server(unique_ptr<Dictionary> dic, const string& dic_name,
+                const CLI_Dict_Finder& finder,
+                const Server_Options& opt) -> int
+{
+	auto state = shared_ptr<Server_State>(new Server_State{
+	    {std::move(dic), dic_name, finder, opt},
+	    {opt.jobs, opt.jobs * 16},
+	    opt.deadline,
+	    opt.max_connections});
+	if (opt.socket_path.empty()) {
+		serve_stdio(state);
+		return 0;
+	}
+#ifdef _POSIX_VERSION
+	return serve_socket(opt.socket_path, state);
+#else
+	clog << "ERROR: Sockets are not supported on this system\n";
+	return EXIT_FAILURE;
+#endif
+}
+
+/**
+ * @brief Sends the lines of standard input to a server and prints the
+ * responses.
+ */
+auto run_client(const string& socket_path) -> int
+{
+#ifdef _POSIX_VERSION
+	auto addr = sockaddr_un();
+	addr.sun_family = AF_UNIX;
+	if (socket_path.size() >= sizeof(addr.sun_path)) {
+		clog << "ERROR: Socket path " << socket_path
+		     << " is too long\n";
+		return EXIT_FAILURE;
+	}
+	socket_path.copy(addr.sun_path, socket_path.size());
+	auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1 || connect(fd, reinterpret_cast<sockaddr*>(&addr),
+	                        sizeof(addr)) == -1) {
+		clog << "ERROR: Can't connect to " << socket_path << ": "
+		     << strerror(errno) << '\n';
+		if (fd != -1)
+			close(fd);
+		return EXIT_FAILURE;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	// the responses are printed while this thread reads cin
+	cin.tie(nullptr);
+	auto reader = thread([fd] {
+		for_each_socket_line(fd, [](string_view line) {
+			if (!line.empty())
+				cout << line << '\n' << flush;
+		});
+	});
+	auto line = string();
+	while (getline(cin, line)) {
+		line += '\n';
+		if (!send_all(fd, line))
+			break;
+	}
+	shutdown(fd, SHUT_WR);
+	reader.join();
+	close(fd);
+	return 0;
+#else
+	(void)socket_path;
+	clog << "ERROR: Sockets are not supported on this system\n";
+	return EXIT_FAILURE;
+#endif
+}
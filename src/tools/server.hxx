@@ -0,0 +1,71 @@
+/* Copyright 2016-2024 Dimitrij Mijoski
+ *
+ * This file is part of Nuspell.
+ *
+ * Nuspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nuspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @brief Server and client modes of the CLI tool, JSON output and finding of
+ * dictionaries.
+ */
+
+#ifndef NUSPELL_TOOLS_SERVER_HXX
+#define NUSPELL_TOOLS_SERVER_HXX
+
+#include <nuspell/dictionary.hxx>
+#include <nuspell/finder.hxx>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Finds dictionaries like Dict_Finder_For_CLI_Tool_2, optionally
+ * through a cache file, option --dictionary-cache.
+ */
+class CLI_Dict_Finder {
+	nuspell::Dict_Finder_For_CLI_Tool_2 finder;
+	std::vector<std::filesystem::path> cached_dicts;
+	bool use_cached_dicts = false;
+
+      public:
+	auto& get_dir_paths() const { return finder.get_dir_paths(); }
+	auto use_cache(const std::filesystem::path& cache_path) -> void;
+	auto get_dictionaries() const -> std::vector<std::filesystem::path>;
+	auto get_dictionary_path(const std::filesystem::path& dict) const
+	    -> std::filesystem::path;
+};
+
+struct Server_Options {
+	std::string socket_path; ///< empty to serve standard input and output
+	size_t jobs = 1;         ///< number of worker threads
+	std::chrono::milliseconds deadline{0}; ///< default deadline, 0 for none
+	size_t max_dictionaries = 16; ///< loaded at the same time
+	size_t max_connections = 64;  ///< served at the same time
+	bool allow_dictionary_paths = false; ///< in requests, not only names
+};
+
+auto run_server(std::unique_ptr<nuspell::Dictionary> dic,
+                const std::string& dic_name,
+                const CLI_Dict_Finder& finder,
+                const Server_Options& opt) -> int;
+auto run_client(const std::string& socket_path) -> int;
+auto append_json_string(std::string_view str, std::string& out) -> void;
+
+#endif // NUSPELL_TOOLS_SERVER_HXX
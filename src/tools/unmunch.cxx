@@ -0,0 +1,247 @@
+/* Copyright 2016-2024 Dimitrij Mijoski
+ *
+ * This file is part of Nuspell.
+ *
+ * Nuspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nuspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <nuspell/dictionary.hxx>
+#include <nuspell/finder.hxx>
+
+#include <charconv>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include <getopt.h>
+
+// manually define if not supplied by the build system
+#ifndef PROJECT_VERSION
+#define PROJECT_VERSION "unknown.version"
+#endif
+
+using namespace std;
+using nuspell::Dictionary, nuspell::Dictionary_Loading_Error,
+    nuspell::Dict_Finder_For_CLI_Tool_2;
+namespace {
+enum Mode { NORMAL, HELP, VERSION };
+auto print_help(const char* program_name) -> void
+{
+	auto p = string_view(program_name);
+	auto& o = cout;
+	o << "Usage:\n"
+	  << p << " [-d dict_NAME] [-j N] [--two-level]\n"
+	  << p << " --help|--version\n"
+	  << R"(
+Print all word forms of a dictionary, one per line, in UTF-8. These are the
+roots and the roots with affixes that are correct on their own, without
+compounding. A form can be printed more than once if it comes from different
+roots.
+
+  -d, --dictionary=di_CT    use di_CT dictionary
+  -j, --jobs=N              use N threads, default is the number of CPUs
+  --two-level               also print forms with two suffixes
+  --help                    print this help
+  --version                 print version number
+
+The option -d works the same as in the tool nuspell. The output is the same
+regardless of the number of threads.
+
+Example:
+)"
+	  << "    " << p << " -d en_US > en_US.txt\n"
+	  << R"(
+Bug reports: <https://github.com/nuspell/nuspell/issues>
+Full documentation: <https://github.com/nuspell/nuspell/wiki>
+Home page: <http://nuspell.github.io/>
+)";
+}
+
+auto ver_str = "nuspell-unmunch " PROJECT_VERSION R"(
+Copyright 2016-2024 Dimitrij Mijoski
+License LGPLv3+: GNU LGPL version 3 or later <http://gnu.org/licenses/lgpl.html>.
+This is free software: you are free to change and redistribute it.
+There is NO WARRANTY, to the extent permitted by law.
+
+Written by Dimitrij Mijoski.
+)";
+
+auto print_version() -> void { cout << ver_str; }
+
+/**
+ * @brief Expands the dictionary into out using multiple threads.
+ *
+ * The word list is split into more parts than threads. The threads take parts
+ * as they become free, and the main thread writes the finished parts in order.
+ */
+auto expand_parallel(const Dictionary& dic, bool two_level, size_t jobs,
+                     ostream& out)
+{
+	auto num_parts = jobs == 1 ? size_t(1) : jobs * 16;
+	// At most this many parts are expanded or wait to be written.
+	auto max_parts = jobs * 4;
+	auto results = deque<string>();
+	auto done = deque<bool>();
+	auto next_part = size_t(0);
+	auto written_parts = size_t(0);
+	auto mtx = mutex();
+	auto can_take = condition_variable();
+	auto part_done = condition_variable();
+	auto worker = [&]() {
+		auto buf = string();
+		for (;;) {
+			size_t part;
+			{
+				auto lock = unique_lock(mtx);
+				can_take.wait(lock, [&] {
+					return next_part == num_parts ||
+					       next_part - written_parts <
+					           max_parts;
+				});
+				if (next_part == num_parts)
+					return;
+				part = next_part++;
+				results.emplace_back();
+				done.push_back(false);
+			}
+			buf.clear();
+			dic.expand_all(
+			    [&](string_view form) {
+				    buf += form;
+				    buf += '\n';
+			    },
+			    two_level, part, num_parts);
+			{
+				auto lock = lock_guard(mtx);
+				results[part - written_parts].swap(buf);
+				done[part - written_parts] = true;
+			}
+			part_done.notify_one();
+		}
+	};
+	auto threads = vector<thread>();
+	for (size_t i = 1; i < jobs; ++i)
+		threads.emplace_back(worker);
+	if (jobs == 1)
+		worker();
+	auto buf = string();
+	for (size_t i = 0; i != num_parts; ++i) {
+		{
+			auto lock = unique_lock(mtx);
+			part_done.wait(lock, [&] {
+				return !done.empty() && done.front();
+			});
+			buf.swap(results.front());
+			results.pop_front();
+			done.pop_front();
+			++written_parts;
+		}
+		can_take.notify_one();
+		out << buf;
+	}
+	can_take.notify_all();
+	for (auto& t : threads)
+		t.join();
+}
+} // namespace
+int main(int argc, char* argv[])
+{
+	auto mode_int = int(Mode::NORMAL);
+	auto program_name = "nuspell-unmunch";
+	auto dictionary = string();
+	auto jobs = size_t(thread::hardware_concurrency());
+	auto two_level = 0;
+
+	if (argc > 0 && argv[0])
+		program_name = argv[0];
+
+	ios_base::sync_with_stdio(false);
+
+	auto optstring = "d:j:";
+	option longopts[] = {
+	    {"help", no_argument, &mode_int, Mode::HELP},
+	    {"version", no_argument, &mode_int, Mode::VERSION},
+	    {"dictionary", required_argument, nullptr, 'd'},
+	    {"jobs", required_argument, nullptr, 'j'},
+	    {"two-level", no_argument, &two_level, 1},
+	    {}};
+	int longindex;
+	int c;
+	while ((c = getopt_long(argc, argv, optstring, longopts, &longindex)) !=
+	       -1) {
+		switch (c) {
+		case 0:
+			// check longopts[longindex] if needed
+			break;
+		case 'd':
+			dictionary = optarg;
+			break;
+		case 'j': {
+			auto arg = string_view(optarg);
+			auto arg_end = arg.data() + arg.size();
+			auto [ptr, ec] = from_chars(arg.data(), arg_end, jobs);
+			if (ec != errc() || ptr != arg_end || jobs == 0) {
+				clog << "ERROR: Invalid number of jobs " << arg
+				     << '\n';
+				return EXIT_FAILURE;
+			}
+			break;
+		}
+		case '?':
+			return EXIT_FAILURE;
+		}
+	}
+	auto mode = static_cast<Mode>(mode_int);
+	if (mode == Mode::VERSION) {
+		print_version();
+		return 0;
+	}
+	else if (mode == Mode::HELP) {
+		print_help(program_name);
+		return 0;
+	}
+	if (optind != argc) {
+		clog << "ERROR: Unexpected argument " << argv[optind] << '\n';
+		return EXIT_FAILURE;
+	}
+	if (jobs == 0)
+		jobs = 1;
+
+	if (dictionary.empty()) {
+		auto denv = getenv("DICTIONARY");
+		if (denv)
+			dictionary = denv;
+	}
+	if (dictionary.empty()) {
+		clog << "ERROR: No dictionary provided\n";
+		return EXIT_FAILURE;
+	}
+	auto f = Dict_Finder_For_CLI_Tool_2();
+	auto filename = f.get_dictionary_path(dictionary);
+	if (filename.empty()) {
+		clog << "ERROR: Dictionary " << dictionary << " not found\n";
+		return EXIT_FAILURE;
+	}
+	auto dic = Dictionary();
+	try {
+		dic.load_aff_dic_internal(filename, clog);
+	}
+	catch (const Dictionary_Loading_Error& e) {
+		clog << "ERROR: " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+	expand_parallel(dic, two_level, jobs, cout);
+}
@@ -16,10 +16,15 @@
  * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers.hpp>
 #include <nuspell/dictionary.hxx>
+#include <nuspell/finder.hxx>
 #include <nuspell/utils.hxx>
+#include <unicode/brkiter.h>
+
+#include <fstream>
 
 using namespace std;
 using namespace nuspell;
@@ -164,6 +169,110 @@ TEST_CASE("Hash_Multimap")
 	REQUIRE(res.first == res.second);
 }
 
+TEST_CASE("Hash_Multimap with filter")
+{
+	auto h = Hash_Multimap<string, int>();
+	REQUIRE_FALSE(h.has_filter());
+	for (auto i = 0; i != 1000; ++i)
+		h.emplace(to_string(i), i);
+	h.build_filter();
+	REQUIRE(h.has_filter());
+	for (auto i = 0; i != 1000; ++i) {
+		auto res = h.equal_range(to_string(i));
+		REQUIRE(res.first != res.second);
+		REQUIRE(res.first->second == i);
+	}
+	auto res = h.equal_range("hello");
+	REQUIRE(res.first == res.second);
+
+	// no false negatives for keys inserted after the filter was built
+	for (auto i = 1000; i != 3000; ++i)
+		h.emplace(to_string(i), i);
+	for (auto i = 0; i != 3000; ++i) {
+		res = h.equal_range(to_string(i));
+		REQUIRE(res.first != res.second);
+		REQUIRE(res.first->second == i);
+	}
+}
+
+TEST_CASE("Perfect_Hash")
+{
+	auto f = Perfect_Hash();
+	REQUIRE(f.empty());
+	auto hashes = vector<size_t>();
+	for (auto i = 0; i != 1000; ++i)
+		hashes.push_back(hash<string>()(to_string(i)));
+	REQUIRE(f.build(hashes));
+	REQUIRE(f.size() == 1000);
+	auto seen = vector<bool>(1000);
+	for (auto h : hashes) {
+		auto i = f(h);
+		REQUIRE(i < 1000);
+		REQUIRE_FALSE(seen[i]);
+		seen[i] = true;
+	}
+
+	hashes.push_back(hashes.front());
+	REQUIRE_FALSE(f.build(hashes));
+	REQUIRE(f.empty());
+}
+
+TEST_CASE("Hash_Multimap with perfect hash")
+{
+	auto h = Hash_Multimap<string, int>();
+	REQUIRE_FALSE(h.build_perfect_hash());
+	for (auto i = 0; i != 1000; ++i) {
+		h.emplace(to_string(i), i);
+		if (i % 10 == 0)
+			h.emplace(to_string(i), -i);
+	}
+	REQUIRE(h.build_perfect_hash());
+	REQUIRE(h.has_perfect_hash());
+	for (auto i = 0; i != 1000; ++i) {
+		auto res = h.equal_range(to_string(i));
+		REQUIRE(res.first != res.second);
+		REQUIRE(res.first->second == i);
+		if (i % 10 == 0) {
+			REQUIRE(next(res.first)->second == -i);
+			REQUIRE(next(res.first, 2) == res.second);
+		}
+		else {
+			REQUIRE(next(res.first) == res.second);
+		}
+	}
+	for (auto i = 1000; i != 2000; ++i) {
+		auto res = h.equal_range(to_string(i));
+		REQUIRE(res.first == res.second);
+	}
+
+	// inserting drops the perfect hash
+	h.emplace("hello", 5);
+	REQUIRE_FALSE(h.has_perfect_hash());
+	auto res = h.equal_range("hello");
+	REQUIRE(res.first != res.second);
+	REQUIRE(res.first->second == 5);
+	res = h.equal_range("999");
+	REQUIRE(res.first != res.second);
+
+	// a copy keeps working after the original is gone
+	REQUIRE(h.build_perfect_hash());
+	auto p = make_unique<Hash_Multimap<string, int>>(h);
+	h = {};
+	REQUIRE(p->has_perfect_hash());
+	auto copy = *p;
+	p.reset();
+	for (auto i = 0; i != 1000; ++i) {
+		auto r = copy.equal_range(to_string(i));
+		REQUIRE(r.first != r.second);
+		REQUIRE(r.first->second == i);
+	}
+	res = copy.equal_range("hello");
+	REQUIRE(res.first != res.second);
+	REQUIRE(res.first->second == 5);
+	REQUIRE(copy.equal_range("1000").first ==
+	        copy.equal_range("1000").second);
+}
+
 TEST_CASE("Condition")
 {
 	auto c = Condition();
@@ -296,6 +405,22 @@ TEST_CASE("Condition")
 	REQUIRE_FALSE(c.match_prefix("abc ШШШ \u2345z\U00011111X"));
 	REQUIRE_FALSE(c.match_prefix("abc АБВ\u2345 t\U00011112Xопop"));
 	REQUIRE_FALSE(c.match_prefix("abc АБВ \u2345z\u1234X"));
+
+	c = "..";
+	REQUIRE(c.match_prefix("ab"));
+	REQUIRE(c.match_prefix("бш\U0010ABCD"));
+	REQUIRE_FALSE(c.match_prefix("б"));
+	REQUIRE_FALSE(c.match_prefix(""));
+	REQUIRE(c.match_suffix("\U0010ABCDш"));
+	REQUIRE_FALSE(c.match_suffix("\U0010ABCD"));
+
+	c = "[абвгд\u1234]";
+	REQUIRE(c.match_prefix("в"));
+	REQUIRE(c.match_prefix("д"));
+	REQUIRE(c.match_prefix("\u1234"));
+	REQUIRE_FALSE(c.match_prefix("е"));
+	REQUIRE_FALSE(c.match_prefix("\u1233"));
+	REQUIRE_FALSE(c.match_prefix("\u1235"));
 }
 
 TEST_CASE("Prefix")
@@ -312,6 +437,29 @@ TEST_CASE("Suffix")
 	REQUIRE(sfx.to_root_copy("pying") == "pie");
 }
 
+TEST_CASE("Affix_Flag_Index")
+{
+	auto sfxs = vector{Suffix{'B', false, "", "s", {}, {}},
+	                   Suffix{'A', false, "", "ed", {}, {}},
+	                   Suffix{'B', false, "y", "ies", {}, {}},
+	                   Suffix{'A', false, "", "ing", {}, {}},
+	                   Suffix{'C', false, "", "er", {}, {}}};
+	auto idx = Affix_Flag_Index();
+	CHECK(idx.empty());
+	idx.build(sfxs, [](auto& x) { return x.appending != "ing"; });
+	auto positions = [&](char16_t flag) {
+		auto r = idx.positions_with(flag);
+		return vector<size_t>(begin(r), end(r));
+	};
+	CHECK_FALSE(idx.empty());
+	CHECK(positions('A') == vector<size_t>{1, 3});
+	CHECK(positions('B') == vector<size_t>{0, 2});
+	CHECK(positions('C') == vector<size_t>{4});
+	CHECK(positions('D').empty());
+	CHECK(idx.is_outer(1));
+	CHECK_FALSE(idx.is_outer(3));
+}
+
 TEST_CASE("Prefix_Multiset")
 {
 	auto set =
@@ -344,6 +492,65 @@ TEST_CASE("Suffix_Multiset")
 	REQUIRE(out == expected);
 }
 
+TEST_CASE("Static_Trie")
+{
+	auto keys = vector<string>{"", "a", "ab", "ab", "abc", "b", "bc"};
+	auto trie = Static_Trie<char>();
+	REQUIRE(trie.empty());
+	trie.build(begin(keys), end(keys), identity());
+	REQUIRE_FALSE(trie.empty());
+
+	auto root = trie.root();
+	REQUIRE(trie.values(root) == pair<size_t, size_t>(0, 1));
+	auto a = trie.child(root, 'a');
+	REQUIRE(a != trie.npos);
+	REQUIRE(trie.values(a) == pair<size_t, size_t>(1, 2));
+	auto ab = trie.child(a, 'b');
+	REQUIRE(ab != trie.npos);
+	REQUIRE(trie.values(ab) == pair<size_t, size_t>(2, 4));
+	REQUIRE(trie.has_children(ab));
+	auto abc = trie.child(ab, 'c');
+	REQUIRE(abc != trie.npos);
+	REQUIRE(trie.has_values(abc));
+	REQUIRE_FALSE(trie.has_children(abc));
+	REQUIRE(trie.child(abc, 'c') == trie.npos);
+	auto b = trie.child(root, 'b');
+	REQUIRE(b != trie.npos);
+	REQUIRE(trie.values(b) == pair<size_t, size_t>(5, 6));
+	REQUIRE(trie.child(root, 'c') == trie.npos);
+}
+
+TEST_CASE("Prefix_Multiset benchmark", "[.][benchmark]")
+{
+	// Many entries that share the same first letters, like the suffix
+	// tables of agglutinative languages.
+	auto keys = vector<string>();
+	for (auto a : "aeiou"s)
+		for (auto b : "klmnrst"s)
+			for (auto c : "aeiou"s)
+				for (auto d : "klmnrst"s)
+					keys.push_back({a, b, c, d});
+	auto set = Suffix_Multiset<string>(keys);
+	auto words = vector<string>{"kalantarak", "mesterekkel", "kerekasztal",
+	                            "tulajdonosokat", "xyz"};
+	BENCHMARK("Iter_Prefixes_Of (trie)")
+	{
+		auto n = size_t();
+		for (auto& w : words)
+			for (auto& x : set.iterate_prefixes_of(w))
+				n += x.size();
+		return n;
+	};
+	BENCHMARK("for_each_prefixes_of (binary search)")
+	{
+		auto n = size_t();
+		for (auto& w : words)
+			set.for_each_prefixes_of(
+			    w, [&](const string& x) { n += x.size(); });
+		return n;
+	};
+}
+
 TEST_CASE("String_Pair")
 {
 	auto x = String_Pair();
@@ -392,6 +599,110 @@ TEST_CASE("match_simple_regex()")
 	REQUIRE_FALSE(match_simple_regex("qwerty"s, "abc?de*ff"s));
 }
 
+TEST_CASE("Compound_Rule_Table")
+{
+	auto t = Compound_Rule_Table({u"abc?de*ff", u"xy*"});
+	auto matches = [&](u16string_view parts) {
+		auto state = t.start_state();
+		auto next = Compound_Rule_Table::State();
+		for (auto p : parts) {
+			if (!t.advance(state, Flag_Set(u16string(1, p)), next))
+				return false;
+			state.swap(next);
+		}
+		return t.is_accepting(state);
+	};
+	CHECK(matches(u"abdff"));
+	CHECK(matches(u"abcdff"));
+	CHECK(matches(u"abdeeff"));
+	CHECK(matches(u"abcdeff"));
+	CHECK(matches(u"x"));
+	CHECK(matches(u"xyyy"));
+	CHECK_FALSE(matches(u""));
+	CHECK_FALSE(matches(u"abcdeeeefff"));
+	CHECK_FALSE(matches(u"abccdeeeeff"));
+	CHECK_FALSE(matches(u"ab"));
+	CHECK_FALSE(matches(u"xyx"));
+
+	auto next = Compound_Rule_Table::State();
+	REQUIRE_FALSE(t.advance(t.start_state(), Flag_Set(u"b"), next));
+	REQUIRE(t.advance(t.start_state(), Flag_Set(u"ax"), next));
+	REQUIRE(t.is_accepting(next));
+
+	// Same results as matching each rule with match_simple_regex(), also
+	// when one of its paths reaches the end of the rule with parts left.
+	auto flag_sets = vector{Flag_Set(u"a"), Flag_Set(u"b"), Flag_Set(u"ab")};
+	auto eq = [](const Flag_Set* d, char16_t p) { return d->contains(p); };
+	for (auto rule : {u"a?b*a"s, u"ab?a*b"s, u"a*b?"s, u"a?"s}) {
+		auto r = Compound_Rule_Table({rule});
+		auto parts = vector<const Flag_Set*>();
+		auto test_all = [&](auto& self, size_t max_parts) -> void {
+			auto state = r.start_state();
+			auto alive = true;
+			for (size_t i = 0; alive && i != parts.size(); ++i) {
+				alive = r.advance(state, *parts[i], next);
+				state.swap(next);
+			}
+			CHECK((alive && r.is_accepting(state)) ==
+			      match_simple_regex(parts, rule, eq));
+			if (parts.size() == max_parts)
+				return;
+			for (auto& f : flag_sets) {
+				parts.push_back(&f);
+				self(self, max_parts);
+				parts.pop_back();
+			}
+		};
+		test_all(test_all, 4);
+	}
+}
+
+TEST_CASE("Replacement_Table")
+{
+	auto t = Replacement_Table({{"^ab$", "1"},
+	                            {"^a", "2"},
+	                            {"b$", "3"},
+	                            {"aa", "4"},
+	                            {"a", "5"},
+	                            {"^ab", "6"},
+	                            {"ab$", "7"},
+	                            {"ba", "8"},
+	                            {"^ab$", "9"}});
+	auto matches = [&](string_view word) {
+		auto m = vector<Replacement_Table::Match>();
+		t.find_matches(word, m);
+		auto out = vector<pair<string, size_t>>();
+		for (auto& x : m)
+			out.emplace_back(t.entry(x.idx).second, x.pos);
+		return out;
+	};
+	// same as looping over the groups one by one
+	auto expected = [&](string_view word) {
+		auto out = vector<pair<string, size_t>>();
+		for (auto& [from, to] : t.whole_word_replacements())
+			if (word == from)
+				out.emplace_back(to, 0);
+		for (auto& [from, to] : t.start_word_replacements())
+			if (begins_with(word, from))
+				out.emplace_back(to, 0);
+		for (auto& [from, to] : t.end_word_replacements())
+			if (ends_with(word, from))
+				out.emplace_back(to, size(word) - size(from));
+		for (auto& [from, to] : t.any_place_replacements())
+			for (auto i = word.find(from); i != word.npos;
+			     i = word.find(from, i + 1))
+				out.emplace_back(to, i);
+		return out;
+	};
+	for (auto w : {"ab", "baaab", "aaaa", "b", "xyz", ""}) {
+		CAPTURE(w);
+		CHECK(matches(w) == expected(w));
+	}
+	CHECK(matches("ab").size() == 7);
+	CHECK(matches("baaab").size() == 8);
+	CHECK(matches("xyz").empty());
+}
+
 TEST_CASE("Similarity_Group")
 {
 	auto sg = Similarity_Group("abc(AB)БШП(ghgh)");
@@ -399,6 +710,60 @@ TEST_CASE("Similarity_Group")
 	REQUIRE(sg.strings == vector{"AB"s, "ghgh"s});
 }
 
+TEST_CASE("Similarity_Table")
+{
+	auto st = Similarity_Table(vector{Similarity_Group("aáà"),
+	                                  Similarity_Group("b(ab)(áx)"),
+	                                  Similarity_Group("cà")});
+	auto groups = [&](char32_t cp) {
+		auto r = st.groups_with(cp);
+		return vector<size_t>(begin(r), end(r));
+	};
+	CHECK(st.size() == 3);
+	CHECK(groups(U'a') == vector<size_t>{0, 1});
+	CHECK(groups(U'á') == vector<size_t>{0, 1});
+	CHECK(groups(U'à') == vector<size_t>{0, 2});
+	CHECK(groups(U'b') == vector<size_t>{1});
+	CHECK(groups(U'c') == vector<size_t>{2});
+	CHECK(groups(U'x').empty());
+}
+
+TEST_CASE("Keyboard_Table")
+{
+	auto kt = Keyboard_Table("qwerty|asdf|zxč|wš");
+	CHECK(kt.neighbors_of(U'q') == "w");
+	CHECK(kt.neighbors_of(U'w') == "qeš");
+	CHECK(kt.neighbors_of(U'y') == "t");
+	CHECK(kt.neighbors_of(U'x') == "zč");
+	CHECK(kt.neighbors_of(U'č') == "x");
+	CHECK(kt.neighbors_of(U'š') == "w");
+	CHECK(kt.neighbors_of(U'b').empty());
+	CHECK(kt.neighbors_of(U'ž').empty());
+}
+
+TEST_CASE("Bigram_Set")
+{
+	auto bs = Bigram_Set();
+	CHECK(bs.empty());
+	bs.insert_bigrams_of("abcа");
+	bs.insert_any_after(U'x');
+	bs.insert_any_before(U'ш');
+	CHECK_FALSE(bs.empty());
+	CHECK(bs.contains(U'a', U'b'));
+	CHECK(bs.contains(U'b', U'c'));
+	CHECK(bs.contains(U'c', U'а'));
+	CHECK_FALSE(bs.contains(U'b', U'a'));
+	CHECK_FALSE(bs.contains(U'a', U'c'));
+	CHECK_FALSE(bs.contains(U'а', U'c'));
+	CHECK(bs.contains(U'x', U'y'));
+	CHECK(bs.contains(U'x', U'ж'));
+	CHECK(bs.contains(U'y', U'ш'));
+	CHECK_FALSE(bs.contains(U'y', U'x'));
+	bs.clear();
+	CHECK(bs.empty());
+	CHECK_FALSE(bs.contains(U'a', U'b'));
+}
+
 TEST_CASE("utf32_to_utf8()")
 {
 	REQUIRE(utf32_to_utf8(U"") == "");
@@ -483,3 +848,172 @@ TEST_CASE("Dict_Base::forgotten_char_suggest()")
 	d.forgotten_char_suggest(in, sugs);
 	REQUIRE(sugs == vector{"абвШгд"s, "абвгдИ"s, "Забвгд"s});
 }
+
+TEST_CASE("Dictionary::build_hot_forms()")
+{
+	auto aff = istringstream("SFX A Y 1\nSFX A 0 ed .\nFORBIDDENWORD F\n");
+	auto dic = istringstream("3\nwork/A\nplay/A\nplayed/F\n");
+	auto d = Dictionary();
+	d.load_aff_dic(aff, dic);
+	auto words = {"work", "worked", "play", "played", "works", "xyz"};
+	auto expected = vector<bool>();
+	for (auto w : words)
+		expected.push_back(d.spell(w));
+	CHECK(expected == vector{true, true, true, false, false, false});
+
+	auto list = istringstream("worked 100\nplayed 50\n\nxyz\nwork\n");
+	d.build_hot_forms(list, 10);
+	auto res = vector<bool>();
+	for (auto w : words)
+		res.push_back(d.spell(w));
+	CHECK(res == expected);
+
+	d.build_hot_forms(10);
+	res.clear();
+	for (auto w : words)
+		res.push_back(d.spell(w));
+	CHECK(res == expected);
+}
+
+TEST_CASE("Dictionary copy")
+{
+	auto aff = istringstream("SFX A Y 1\nSFX A 0 ed .\n");
+	auto dic = istringstream("3\nwork/A\nplay\nplay/A\n");
+	auto d = make_unique<Dictionary>();
+	d->load_aff_dic(aff, dic);
+	auto copy = *d;
+	d.reset();
+	auto words = {"work", "worked", "play", "played", "works", "xyz"};
+	auto res = vector<bool>();
+	for (auto w : words)
+		res.push_back(copy.spell(w));
+	CHECK(res == vector{true, true, true, true, false, false});
+}
+
+TEST_CASE("search_dirs_for_dicts_cached()")
+{
+	namespace fs = std::filesystem;
+	auto tmp = fs::temp_directory_path() / "nuspell_unit_test_dict_cache";
+	fs::remove_all(tmp);
+	auto dir = tmp / "dicts";
+	fs::create_directories(dir);
+	auto add_file = [&](const char* name) { ofstream(dir / name); };
+	add_file("aa_AA.aff");
+	add_file("aa_AA.dic");
+	add_file("bb.aff"); // not a dictionary without .dic
+	auto cache = tmp / "cache" / "dictionaries";
+	auto dirs = vector<fs::path>{dir, tmp / "missing"};
+	auto search = [&] {
+		auto dicts = vector<fs::path>();
+		search_dirs_for_dicts_cached(dirs, cache, dicts);
+		return dicts;
+	};
+	auto expected = vector<fs::path>{dir / "aa_AA.aff"};
+	auto old_time = fs::file_time_type::clock::now() - chrono::hours(1);
+	fs::last_write_time(dir, old_time);
+	CHECK(search() == expected);
+	CHECK(fs::exists(cache));
+	CHECK(search() == expected);
+
+	// The cache is used while the time of the directory is the same.
+	add_file("bb.dic");
+	fs::last_write_time(dir, old_time);
+	CHECK(search() == expected);
+
+	fs::last_write_time(dir, old_time + chrono::minutes(1));
+	auto dicts = search();
+	sort(begin(dicts), end(dicts));
+	expected.push_back(dir / "bb.aff");
+	CHECK(dicts == expected);
+
+	// Corrupted cache is ignored.
+	ofstream(cache) << "garbage\n";
+	dicts = search();
+	sort(begin(dicts), end(dicts));
+	CHECK(dicts == expected);
+	fs::remove_all(tmp);
+}
+
+TEST_CASE("Dictionary::tokenize()")
+{
+	auto tokenize = [](const Dictionary& d, string_view text) {
+		auto words = vector<string>();
+		d.tokenize(text,
+		           [&](string_view w) { words.emplace_back(w); });
+		return words;
+	};
+	SECTION("same as ICU break iterator")
+	{
+		auto aff = istringstream("BREAK 0\n");
+		auto dic = istringstream("1\nword\n");
+		auto d = Dictionary();
+		d.load_aff_dic(aff, dic);
+		auto err = U_ZERO_ERROR;
+		auto brk = unique_ptr<icu::BreakIterator>(
+		    icu::BreakIterator::createWordInstance(icu::Locale(), err));
+		auto utext = icu::LocalUTextPointer(
+		    utext_openUTF8(nullptr, "", 0, &err));
+		auto icu_tokenize = [&](string_view text) {
+			auto words = vector<string>();
+			utext_openUTF8(utext.getAlias(), text.data(),
+			               text.size(), &err);
+			brk->setText(utext.getAlias(), err);
+			for (auto i = brk->first(), prev = 0; i != brk->DONE;
+			     prev = i, i = brk->next())
+				if (brk->getRuleStatus() >= UBRK_WORD_NUMBER &&
+				    brk->getRuleStatus() < UBRK_WORD_IDEO_LIMIT)
+					words.emplace_back(
+					    text.substr(prev, i - prev));
+			return words;
+		};
+		auto texts = {
+		    "Hello, world! It's 3.14 and 1,000.5 apples.",
+		    "e.g. don’t stop; a:b x'y' 'quoted' end.",
+		    "naïve café crème   brûlée",
+		    "foo_bar _ __init__ x_1 _9",
+		    "Привет, мир!",
+		    "ελληνικά "
+		    "עברית a·b",
+		    "2024-10-18 tab\tsep  spaces \U0001F44D\U0001F3FD ok",
+		    "soft­hyphen well-known x-ray a.1 1.a",
+		    ""};
+		for (auto t : texts) {
+			CAPTURE(t);
+			CHECK(tokenize(d, t) == icu_tokenize(t));
+		}
+		CHECK(U_SUCCESS(err));
+	}
+	SECTION("WORDCHARS and BREAK")
+	{
+		auto aff = istringstream("WORDCHARS /\n");
+		auto dic = istringstream("1\nword\n");
+		auto d = Dictionary();
+		d.load_aff_dic(aff, dic);
+		auto words = tokenize(d, "well-known -dash and/or /x y-");
+		CHECK(words ==
+		      vector<string>{"well-known", "dash", "and/or", "x", "y"});
+	}
+}
+
+TEST_CASE("Dict_Base::expand_root_word()")
+{
+	auto d = nuspell::Suggester();
+	d.need_affix_flag = 'X';
+	d.suffixes = vector{Suffix{'A', true, "", "ed", {}, {}},
+	                    Suffix{'B', false, "", "s", {}, {}},
+	                    Suffix{'C', true, "", "er", Flag_Set(u"B"), {}}};
+	d.prefixes = vector{Prefix{'P', true, "", "re", {}, {}},
+	                    Prefix{'Q', false, "", "un", {}, {}}};
+	d.words.emplace("work", u"ACPQ");
+	d.words.emplace("play", u"AX");
+	auto forms = vector<string>();
+	auto& work = *d.words.equal_range("work").first;
+	d.expand_root_word(work, false, forms);
+	CHECK(forms == vector{"work"s, "worked"s, "reworked"s, "worker"s,
+	                      "reworker"s, "rework"s, "unwork"s});
+	d.expand_root_word(work, true, forms);
+	CHECK(forms == vector{"work"s, "worked"s, "reworked"s, "worker"s,
+	                      "reworker"s, "workers"s, "rework"s, "unwork"s});
+	d.expand_root_word(*d.words.equal_range("play").first, true, forms);
+	CHECK(forms == vector{"played"s});
+}
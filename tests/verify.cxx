@@ -19,6 +19,7 @@
 #include <hunspell/hunspell.hxx>
 #include <nuspell/dictionary.hxx>
 #include <nuspell/finder.hxx>
+#include <nuspell/utils.hxx>
 
 #include <chrono>
 #include <clocale>
@@ -33,8 +34,6 @@
 #endif
 #ifdef _POSIX_VERSION
 #include <langinfo.h>
-#include <sys/resource.h>
-#include <sys/time.h>
 #endif
 #ifdef _WIN32
 #include <io.h>
@@ -43,8 +42,6 @@
 #endif
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
-
-#include <psapi.h>
 #endif
 
 // manually define if not supplied by the build system
@@ -54,7 +51,7 @@
 
 using namespace std;
 using nuspell::Dictionary, nuspell::Dictionary_Loading_Error,
-    nuspell::Dict_Finder_For_CLI_Tool_2;
+    nuspell::Dict_Finder_For_CLI_Tool_2, nuspell::get_peak_ram_usage;
 namespace {
 enum Mode { NORMAL, HELP, VERSION };
 auto print_help(const char* program_name) -> void
@@ -102,22 +99,6 @@ Written by Dimitrij Mijoski.
 
 auto print_version() -> void { cout << ver_str; }
 
-auto get_peak_ram_usage() -> long
-{
-#ifdef _POSIX_VERSION
-	rusage r;
-	auto err = getrusage(RUSAGE_SELF, &r);
-	if (!err)
-		return r.ru_maxrss;
-#elif _WIN32
-	PROCESS_MEMORY_COUNTERS pmc;
-	auto suc = GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
-	if (suc)
-		return pmc.PeakWorkingSetSize >> 10;
-#endif
-	return 0;
-}
-
 auto to_utf8(string_view source, string& dest, UConverter* ucnv,
              UErrorCode& uerr)
 {